@@ -0,0 +1,127 @@
+#pragma once
+
+#include "compressed_tuple.h"  // SMART_PTRS_NO_UNIQUE_ADDRESS
+#include "unique.h"
+
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Inline storage of `AnyDeleter`; the zero-size form takes no space at all.
+template <size_t Size>
+struct AnyDeleterBuffer {
+    void* Get() {
+        return data;
+    }
+
+    alignas(void*) std::byte data[Size];
+};
+
+template <>
+struct AnyDeleterBuffer<0> {
+    void* Get() {
+        return nullptr;
+    }
+};
+
+// Type-erased deleter for `UniquePtr<T, AnyDeleter<T>>`, so objects released through
+// different pools or allocators share one pointer type. Deleters up to `InlineSize` bytes are
+// stored inline; larger ones are rejected at compile time rather than boxed on the heap.
+// Empty deleters are not stored at all, so `AnyDeleter<T, 0>` is a single function pointer.
+// Every operation dispatches through that pointer. A default-constructed deleter uses `delete`.
+template <typename T, size_t InlineSize = 2 * sizeof(void*)>
+class AnyDeleter {
+    enum class Operation { kInvoke, kMove, kDestroy };
+
+    using Manager = void (*)(Operation operation, AnyDeleter* self, void* argument);
+
+    template <typename D>
+    static constexpr bool kStateless = std::is_empty_v<D> && std::default_initializable<D>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    AnyDeleter() : manager_(&Manage<DefaultDeleter<T>>) {
+    }
+
+    template <typename D>
+    requires(!std::same_as<std::decay_t<D>, AnyDeleter> && std::invocable<std::decay_t<D>&, T*>)
+    AnyDeleter(D&& deleter) : AnyDeleter(std::in_place_type<std::decay_t<D>>,
+                                         std::forward<D>(deleter)) {
+    }
+
+    template <typename D, typename... Args>
+    explicit AnyDeleter(std::in_place_type_t<D>, Args&&... args) : manager_(&Manage<D>) {
+        static_assert(std::is_nothrow_move_constructible_v<D>, "moves must stay noexcept");
+        if constexpr (!kStateless<D>) {
+            static_assert(sizeof(D) <= InlineSize, "deleter does not fit the inline buffer");
+            static_assert(alignof(D) <= alignof(void*), "deleter is over-aligned");
+            std::construct_at(static_cast<D*>(buffer_.Get()), std::forward<Args>(args)...);
+        }
+    }
+
+    AnyDeleter(AnyDeleter&& other) noexcept : manager_(other.manager_) {
+        manager_(Operation::kMove, &other, this);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    AnyDeleter& operator=(AnyDeleter&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        manager_(Operation::kDestroy, this, nullptr);
+        manager_ = other.manager_;
+        manager_(Operation::kMove, &other, this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~AnyDeleter() {
+        manager_(Operation::kDestroy, this, nullptr);
+    }
+
+    void operator()(T* ptr) const noexcept {
+        manager_(Operation::kInvoke, const_cast<AnyDeleter*>(this), ptr);
+    }
+
+private:
+    template <typename D>
+    static D* Stored(AnyDeleter* self) {
+        return std::launder(static_cast<D*>(self->buffer_.Get()));
+    }
+
+    template <typename D>
+    static void Manage(Operation operation, AnyDeleter* self, void* argument) {
+        if constexpr (kStateless<D>) {
+            if (operation == Operation::kInvoke) {
+                D()(static_cast<T*>(argument));
+            }
+        } else {
+            switch (operation) {
+                case Operation::kInvoke:
+                    (*Stored<D>(self))(static_cast<T*>(argument));
+                    break;
+                case Operation::kMove: {
+                    auto destination = static_cast<AnyDeleter*>(argument);
+                    std::construct_at(static_cast<D*>(destination->buffer_.Get()),
+                                      std::move(*Stored<D>(self)));
+                    break;
+                }
+                case Operation::kDestroy:
+                    std::destroy_at(Stored<D>(self));
+                    break;
+            }
+        }
+    }
+
+    Manager manager_;
+    SMART_PTRS_NO_UNIQUE_ADDRESS AnyDeleterBuffer<InlineSize> buffer_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>  // std::tuple_element_t
+#include <type_traits>
+#include <utility>
+
+// MSVC ignores the standard spelling and needs its own.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SMART_PTRS_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define SMART_PTRS_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+// One element of a `CompressedTuple`. `Index` keeps leaves of equal types distinct.
+template <size_t Index, typename T>
+struct CompressedLeaf {
+    constexpr CompressedLeaf() = default;
+
+    template <typename U>
+    constexpr explicit CompressedLeaf(std::in_place_t, U&& value)
+            : value(std::forward<U>(value)) {
+    }
+
+    SMART_PTRS_NO_UNIQUE_ADDRESS T value{};
+};
+
+template <typename Indices, typename... Ts>
+class CompressedTupleStorage;
+
+template <size_t... Indices, typename... Ts>
+class CompressedTupleStorage<std::index_sequence<Indices...>, Ts...>
+        : protected CompressedLeaf<Indices, Ts>... {
+protected:
+    constexpr CompressedTupleStorage() = default;
+
+    template <typename... Args>
+    constexpr explicit CompressedTupleStorage(std::in_place_t, Args&&... args)
+            : CompressedLeaf<Indices, Ts>(std::in_place, std::forward<Args>(args))... {
+    }
+};
+
+// Tuple in which empty elements take no space, final ones included. Copies, moves and
+// destruction are left implicit, so the tuple is trivially copyable whenever all of its
+// elements are.
+template <typename... Ts>
+class CompressedTuple : private CompressedTupleStorage<std::index_sequence_for<Ts...>, Ts...> {
+    using Storage = CompressedTupleStorage<std::index_sequence_for<Ts...>, Ts...>;
+
+    template <size_t Index>
+    using Leaf = CompressedLeaf<Index, std::tuple_element_t<Index, std::tuple<Ts...>>>;
+
+public:
+    constexpr CompressedTuple() = default;
+
+    template <typename... Args>
+    requires(sizeof...(Args) == sizeof...(Ts) && sizeof...(Ts) > 0 &&
+             (std::is_constructible_v<Ts, Args> && ...))
+    constexpr CompressedTuple(Args&&... args)
+            : Storage(std::in_place, std::forward<Args>(args)...) {
+    }
+
+    template <size_t Index>
+    constexpr auto& Get() {
+        return static_cast<Leaf<Index>&>(*this).value;
+    }
+
+    template <size_t Index>
+    constexpr const auto& Get() const {
+        return static_cast<const Leaf<Index>&>(*this).value;
+    }
+};
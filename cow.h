@@ -0,0 +1,70 @@
+#pragma once
+
+#include "shared.h"
+
+#include <concepts>
+#include <utility>
+
+// Copy-on-write value: copies share one object, and `Mutate` clones it first unless this
+// pointer is its only owner. Clones go through `MakeShared`, so each is a single allocation;
+// a value adopted with a custom deleter or from a pool loses that on its first clone.
+template <typename T>
+class CowPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    CowPtr() requires std::default_initializable<T> : value_(MakeShared<T>()) {
+    }
+
+    explicit CowPtr(SharedPtr<T> value) : value_(std::move(value)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Write access. A `WeakPtr` could still revive a uniquely owned object, so it counts as
+    // a sharer too, except for the object's own `EnableSharedFromThis` reference.
+    T& Mutate() {
+        if (!value_.IsSoleOwner()) {
+            value_ = MakeShared<T>(std::as_const(*value_));
+        }
+        return *value_;
+    }
+
+    void Swap(CowPtr& other) noexcept {
+        value_.Swap(other.value_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    const T* Get() const {
+        return value_.Get();
+    }
+
+    const T& operator*() const {
+        return *value_;
+    }
+
+    const T* operator->() const {
+        return value_.Get();
+    }
+
+    size_t UseCount() const {
+        return value_.UseCount();
+    }
+
+    // Read-only sharing with code that works with `SharedPtr`s.
+    SharedPtr<const T> Share() const {
+        return value_;
+    }
+
+private:
+    SharedPtr<T> value_;
+};
+
+template <typename T, typename... Args>
+CowPtr<T> MakeCow(Args&&... args) {
+    return CowPtr<T>(MakeShared<T>(std::forward<Args>(args)...));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdlib>  // std::abort
+
+// Exceptions are used unless the compiler has them switched off (`-fno-exceptions`) or the
+// build defines SMART_PTRS_NO_EXCEPTIONS. Without them, every throw site aborts instead and
+// cleanup handlers compile away; the `Try*`/`*OrNull` functions report failure without either.
+#if !defined(SMART_PTRS_NO_EXCEPTIONS) && !defined(__cpp_exceptions)
+#define SMART_PTRS_NO_EXCEPTIONS
+#endif
+
+#ifdef SMART_PTRS_NO_EXCEPTIONS
+#define SMART_PTRS_TRY if (true)
+#define SMART_PTRS_CATCH_ALL if (false)
+#define SMART_PTRS_RETHROW
+#else
+#define SMART_PTRS_TRY try
+#define SMART_PTRS_CATCH_ALL catch (...)
+#define SMART_PTRS_RETHROW throw
+#endif
+
+// Throws `exception`, or aborts when exceptions are off.
+template <typename Exception>
+[[noreturn]] void ThrowOrAbort(const Exception& exception) {
+#ifdef SMART_PTRS_NO_EXCEPTIONS
+    (void)exception;
+    std::abort();
+#else
+    throw exception;
+#endif
+}
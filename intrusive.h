@@ -1,17 +1,29 @@
 #pragma once
 
+#include "shared.h"
+
+#include <cassert>
 #include <cstddef>  // for std::nullptr_t
+#include <cstdint>  // for uintptr_t
+#include <limits>   // for std::numeric_limits
 #include <utility>  // for std::exchange / std::swap
 
 class SimpleCounter {
 public:
-    size_t IncRef() {
-        ++count_;
+    // Sentinel count of immortal objects; increments and decrements leave it untouched.
+    static constexpr size_t kImmortal = std::numeric_limits<size_t>::max();
+
+    size_t IncRef(size_t count = 1) {
+        if (count_ != kImmortal) {
+            count_ += count;
+        }
         return count_;
     }
 
-    size_t DecRef() {
-        --count_;
+    size_t DecRef(size_t count = 1) {
+        if (count_ != kImmortal) {
+            count_ -= count;
+        }
         return count_;
     }
 
@@ -19,8 +31,21 @@ public:
         return count_;
     }
 
+    constexpr void MakeImmortal() {
+        count_ = kImmortal;
+    }
+
+    bool IsImmortal() const {
+        return count_ == kImmortal;
+    }
+
+    // Storage `Teardown` may use as a link once the count has dropped to zero.
+    uintptr_t& TeardownLink() {
+        return count_;
+    }
+
 private:
-    size_t count_ = 0;
+    uintptr_t count_ = 0;
 };
 
 struct DefaultDelete {
@@ -42,11 +67,43 @@ public:
     // Destroy object using Deleter when the last instance dies.
     void DecRef() {
         if (RefCount() == 0) {
-            Deleter::Destroy(static_cast<Derived*>(this));
+            Dispose();
             return;
         }
         if (counter_.DecRef() == 0) {
-            Deleter::Destroy(static_cast<Derived*>(this));
+            Dispose();
+        }
+    }
+
+    // Split form of `DecRef` for batched releases: returns true when `Dispose` is due.
+    bool DropRef() {
+        if (RefCount() == 0) {
+            return true;
+        }
+        return counter_.DecRef() == 0;
+    }
+
+    // Destroys the object. Past `Teardown::kMaxDepth` nested disposals it is queued instead,
+    // provided the counter has a spare word to link it through.
+    void Dispose() {
+        if constexpr (requires { counter_.TeardownLink(); }) {
+            if (Teardown::TooDeep()) {
+                Teardown::Push<TeardownTraits>(this);
+                return;
+            }
+        }
+        Teardown::Scope scope;
+        Deleter::Destroy(static_cast<Derived*>(this));
+    }
+
+    // Bulk forms, for counters that take a count.
+    void IncRef(size_t count) {
+        counter_.IncRef(count);
+    }
+
+    void DecRef(size_t count) {
+        if (counter_.DecRef(count) == 0) {
+            Dispose();
         }
     }
 
@@ -55,15 +112,134 @@ public:
         return counter_.RefCount();
     }
 
+    // Pin the object: from now on the counter is never changed and the object never destroyed.
+    constexpr void MakeImmortal() {
+        counter_.MakeImmortal();
+    }
+
+    bool IsImmortal() const {
+        return counter_.IsImmortal();
+    }
+
+    // Only for counters that support weak references (see `WeakCounter`).
+    auto GetSideTable() {
+        return counter_.GetSideTable();
+    }
+
     //    virtual ~RefCounted() = default;
 
 private:
+    struct TeardownTraits {
+        static RefCounted* Next(RefCounted* object) {
+            return reinterpret_cast<RefCounted*>(object->counter_.TeardownLink());
+        }
+
+        static void SetNext(RefCounted* object, RefCounted* next) {
+            object->counter_.TeardownLink() = reinterpret_cast<uintptr_t>(next);
+        }
+
+        static void Run(RefCounted* object) {
+            object->counter_.TeardownLink() = 0;
+            Deleter::Destroy(static_cast<Derived*>(object));
+        }
+    };
+
     Counter counter_;
 };
 
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+// Counter tag: embed a whole `ControlBlock` instead of a plain counter, so `SharedPtr`
+// adopts the object's own count and never allocates a second one.
+struct SharedCounter {};
+
+template <typename Derived, typename Deleter>
+class RefCounted<Derived, SharedCounter, Deleter> : private ControlBlock {
+public:
+    RefCounted() : ControlBlock(0) {
+    }
+
+    // The embedded block is not copied: the copy starts with no owners and no observers.
+    RefCounted(const RefCounted&) : ControlBlock(0) {
+    }
+
+    RefCounted& operator=(const RefCounted&) {
+        return *this;
+    }
+
+    void IncRef(size_t count = 1) {
+        IncStrong(count);
+    }
+
+    // The object outlives its last strong reference while `WeakPtr`s still observe the block.
+    void DecRef(size_t count = 1) {
+        if (strong_count == 0) {
+            Deallocate();
+            return;
+        }
+        if (DecStrong(count)) {
+            ReleaseLastStrong();
+        }
+    }
+
+    size_t RefCount() const {
+        return strong_count;
+    }
+
+    // A true result pins the block, as `BatchRelease` does for `SharedPtr`s, so that a
+    // `WeakPtr` dropped by an earlier disposal cannot free the object before its `Dispose`.
+    bool DropRef() {
+        if (strong_count == 0 || DecStrong()) {
+            ++weak_count;
+            return true;
+        }
+        return false;
+    }
+
+    // Only after `DropRef` returned true; releases its pin.
+    void Dispose() {
+        --weak_count;
+        ReleaseLastStrong();
+    }
+
+    constexpr void MakeImmortal() {
+        strong_count = kImmortal;
+    }
+
+    bool IsImmortal() const {
+        return ControlBlock::IsImmortal();
+    }
+
+    ControlBlock* GetControlBlock() {
+        return this;
+    }
+
+private:
+    ControlBlock& DeleterPointer() override {
+        alive = false;
+        return *this;
+    }
+
+    void Deallocate() override {
+        Deleter::Destroy(static_cast<Derived*>(this));
+    }
+};
+
+template <typename Derived, typename D = DefaultDelete>
+using SharedRefCounted = RefCounted<Derived, SharedCounter, D>;
+
+// `RefCounted` object that is immortal from construction on. With a constexpr constructor
+// of `T` it can be `constinit`, and so can the `IntrusivePtr`s to it.
+template <typename T>
+class Immortal : public T {
+public:
+    template <typename... Args>
+    constexpr explicit Immortal(Args&&... args) : T(std::forward<Args>(args)...) {
+        this->MakeImmortal();
+    }
+};
+
 template <typename T>
 class IntrusivePtr {
     template <typename Y>
@@ -83,20 +259,31 @@ public:
         AddPointer();
     }
 
+    // With `add_ref == false` adopts a reference previously given up by `Detach`.
+    IntrusivePtr(T* ptr, bool add_ref) : pointer_(ptr) {
+        if (add_ref) {
+            AddPointer();
+        }
+    }
+
+    // The counter of an immortal object is never touched, so no `IncRef` is needed.
+    constexpr IntrusivePtr(Immortal<T>* ptr) : pointer_(ptr) {
+    }
+
     template <typename Y>
     IntrusivePtr(const IntrusivePtr<Y>& other) : pointer_(other.pointer_) {
         AddPointer();
     }
 
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) : pointer_(std::move(other.pointer_)) {
+    IntrusivePtr(IntrusivePtr<Y>&& other) noexcept : pointer_(std::move(other.pointer_)) {
         other.pointer_ = nullptr;
     }
 
     IntrusivePtr(const IntrusivePtr& other) : pointer_(other.pointer_) {
         AddPointer();
     }
-    IntrusivePtr(IntrusivePtr&& other) : pointer_(std::move(other.pointer_)) {
+    IntrusivePtr(IntrusivePtr&& other) noexcept : pointer_(std::move(other.pointer_)) {
         other.pointer_ = nullptr;
     }
 
@@ -110,7 +297,7 @@ public:
         AddPointer();
         return *this;
     }
-    IntrusivePtr& operator=(IntrusivePtr&& other) {
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
@@ -135,10 +322,15 @@ public:
         pointer_ = ptr;
         AddPointer();
     }
-    void Swap(IntrusivePtr& other) {
+    void Swap(IntrusivePtr& other) noexcept {
         std::swap(pointer_, other.pointer_);
     }
 
+    // Gives up the reference without `DecRef`; the caller now owns it.
+    T* Detach() noexcept {
+        return std::exchange(pointer_, nullptr);
+    }
+
     // Observers
     T* Get() const {
         return pointer_;
@@ -162,6 +354,47 @@ public:
         return pointer_;
     }
 
+    // Bulk operations
+    // Writes `count` copies to `out` with a single `IncRef(count)`. If writing to `out`
+    // throws, one `DecRef` takes back what was not written.
+    template <typename OutputIt>
+    OutputIt ShareN(OutputIt out, size_t count) const {
+        if (pointer_ && count) {
+            pointer_->IncRef(count);
+        }
+        SMART_PTRS_TRY {
+            for (; count; ++out) {
+                IntrusivePtr copy(pointer_, false);
+                --count;
+                *out = std::move(copy);
+            }
+        } SMART_PTRS_CATCH_ALL {
+            if (pointer_ && count) {
+                pointer_->DecRef(count);
+            }
+            SMART_PTRS_RETHROW;
+        }
+        return out;
+    }
+
+    // Empties every pointer in `[first, last)`, which must all point to one object
+    // (or be empty), dropping their references with a single `DecRef(count)`.
+    template <typename ForwardIt>
+    static void ReleaseMany(ForwardIt first, ForwardIt last) {
+        T* object = nullptr;
+        size_t count = 0;
+        for (; first != last; ++first) {
+            if (T* pointer = static_cast<IntrusivePtr&>(*first).Detach()) {
+                assert((!object || object == pointer) && "ReleaseMany over different objects");
+                object = pointer;
+                ++count;
+            }
+        }
+        if (object) {
+            object->DecRef(count);
+        }
+    }
+
 private:
     void AddPointer() {
         if (pointer_) {
@@ -184,3 +417,52 @@ IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     auto new_intrusive = new T(std::forward<Args>(args)...);
     return IntrusivePtr(new_intrusive);
 }
+
+// Casts mirroring the `SharedPtr` ones; the rvalue overloads reuse the reference they are given.
+template <typename T, typename U>
+IntrusivePtr<T> StaticPointerCast(const IntrusivePtr<U>& pointer) {
+    return IntrusivePtr<T>(static_cast<T*>(pointer.Get()));
+}
+
+template <typename T, typename U>
+IntrusivePtr<T> StaticPointerCast(IntrusivePtr<U>&& pointer) {
+    return IntrusivePtr<T>(static_cast<T*>(pointer.Detach()), false);
+}
+
+template <typename T, typename U>
+IntrusivePtr<T> DynamicPointerCast(const IntrusivePtr<U>& pointer) {
+    return IntrusivePtr<T>(dynamic_cast<T*>(pointer.Get()));
+}
+
+// `pointer` keeps its reference when the cast fails.
+template <typename T, typename U>
+IntrusivePtr<T> DynamicPointerCast(IntrusivePtr<U>&& pointer) {
+    if (auto raw = dynamic_cast<T*>(pointer.Get())) {
+        pointer.Detach();
+        return IntrusivePtr<T>(raw, false);
+    }
+    return IntrusivePtr<T>();
+}
+
+template <typename T, typename U>
+IntrusivePtr<T> ConstPointerCast(const IntrusivePtr<U>& pointer) {
+    return IntrusivePtr<T>(const_cast<T*>(pointer.Get()));
+}
+
+template <typename T, typename U>
+IntrusivePtr<T> ConstPointerCast(IntrusivePtr<U>&& pointer) {
+    return IntrusivePtr<T>(const_cast<T*>(pointer.Detach()), false);
+}
+
+// Both directions share the object's embedded count, so neither allocates.
+template <typename T>
+requires EmbedsControlBlock<T>
+SharedPtr<T> ToShared(const IntrusivePtr<T>& pointer) {
+    return SharedPtr<T>(pointer.Get());
+}
+
+template <typename T>
+requires EmbedsControlBlock<T>
+IntrusivePtr<T> ToIntrusive(const SharedPtr<T>& pointer) {
+    return IntrusivePtr<T>(pointer.Get());
+}
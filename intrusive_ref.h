@@ -0,0 +1,89 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <cassert>
+#include <utility>  // for std::swap
+
+// Non-nullable `IntrusivePtr`: copies, destruction and dereferences never test for null.
+// There is no moved-from state; moving copies.
+template <typename T>
+class IntrusiveRef {
+    template <typename Y>
+    friend class IntrusiveRef;
+
+public:
+    // Constructors
+    explicit IntrusiveRef(T& object) : pointer_(&object) {
+        pointer_->IncRef();
+    }
+
+    template <typename Y>
+    explicit IntrusiveRef(const IntrusivePtr<Y>& other) : pointer_(other.Get()) {
+        assert(pointer_ && "IntrusiveRef from a null IntrusivePtr");
+        pointer_->IncRef();
+    }
+
+    // Takes over the reference of `other`, which is left empty.
+    template <typename Y>
+    explicit IntrusiveRef(IntrusivePtr<Y>&& other) : pointer_(other.Detach()) {
+        assert(pointer_ && "IntrusiveRef from a null IntrusivePtr");
+    }
+
+    IntrusiveRef(const IntrusiveRef& other) : pointer_(other.pointer_) {
+        pointer_->IncRef();
+    }
+
+    template <typename Y>
+    IntrusiveRef(const IntrusiveRef<Y>& other) : pointer_(other.pointer_) {
+        pointer_->IncRef();
+    }
+
+    // `operator=`-s
+    // No self-assignment check needed: `other` gains its reference before ours is dropped.
+    IntrusiveRef& operator=(const IntrusiveRef& other) {
+        other.pointer_->IncRef();
+        pointer_->DecRef();
+        pointer_ = other.pointer_;
+        return *this;
+    }
+
+    // Destructor
+    ~IntrusiveRef() {
+        pointer_->DecRef();
+    }
+
+    // Modifiers
+    void Swap(IntrusiveRef& other) noexcept {
+        std::swap(pointer_, other.pointer_);
+    }
+
+    // Observers
+    T* Get() const {
+        return pointer_;
+    }
+
+    T& operator*() const {
+        return *pointer_;
+    }
+
+    T* operator->() const {
+        return pointer_;
+    }
+
+    size_t UseCount() const {
+        return pointer_->RefCount();
+    }
+
+    IntrusivePtr<T> ToIntrusive() const {
+        return IntrusivePtr<T>(pointer_);
+    }
+
+private:
+    T* pointer_;
+};
+
+template <typename T, typename... Args>
+IntrusiveRef<T> MakeIntrusiveRef(Args&&... args) {
+    return IntrusiveRef<T>(*new T(std::forward<Args>(args)...));
+}
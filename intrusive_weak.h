@@ -0,0 +1,217 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <cstddef>  // for std::nullptr_t
+#include <cstdint>  // for uintptr_t
+#include <utility>  // for std::swap
+
+// Out-of-line counts of an object that has been weakly referenced at least once.
+struct IntrusiveSideTable {
+    size_t strong_count;
+    // Weak references plus one held by the object itself until it dies.
+    size_t weak_count = 1;
+};
+
+// Counter that stays a single word until the first weak reference is taken. Then the strong
+// count moves into a lazily allocated `IntrusiveSideTable` and the word points at it.
+class WeakCounter {
+public:
+    WeakCounter() = default;
+
+    // The side table stays with the original; the copy starts at zero without one.
+    WeakCounter(const WeakCounter&) {
+    }
+
+    WeakCounter& operator=(const WeakCounter&) {
+        return *this;
+    }
+
+    ~WeakCounter() {
+        if (auto table = Table()) {
+            table->strong_count = 0;
+            ReleaseSideTable(table);
+        }
+    }
+
+    size_t IncRef(size_t count = 1) {
+        if (auto table = Table()) {
+            return table->strong_count += count;
+        }
+        bits_ += count * kOne;
+        return bits_ / kOne;
+    }
+
+    size_t DecRef(size_t count = 1) {
+        if (auto table = Table()) {
+            return table->strong_count -= count;
+        }
+        bits_ -= count * kOne;
+        return bits_ / kOne;
+    }
+
+    size_t RefCount() const {
+        if (auto table = Table()) {
+            return table->strong_count;
+        }
+        return bits_ / kOne;
+    }
+
+    IntrusiveSideTable* GetSideTable() {
+        if (!Table()) {
+            auto table = new IntrusiveSideTable{bits_ / kOne};
+            bits_ = reinterpret_cast<uintptr_t>(table) | kSideTableBit;
+        }
+        return Table();
+    }
+
+    // Lends `bits_` to `Teardown` after the last strong reference. Only expired
+    // `IntrusiveWeakPtr`s still read the side table, so the object's share of it goes first.
+    uintptr_t& TeardownLink() {
+        if (auto table = Table()) {
+            ReleaseSideTable(table);
+            bits_ = 0;
+        }
+        return bits_;
+    }
+
+    static void ReleaseSideTable(IntrusiveSideTable* table) {
+        if (--table->weak_count == 0) {
+            delete table;
+        }
+    }
+
+private:
+    static constexpr uintptr_t kSideTableBit = 1;
+    static constexpr uintptr_t kOne = 2;
+
+    IntrusiveSideTable* Table() const {
+        if (bits_ & kSideTableBit) {
+            return reinterpret_cast<IntrusiveSideTable*>(bits_ & ~kSideTableBit);
+        }
+        return nullptr;
+    }
+
+    // Either `count * kOne` or the side table address tagged with `kSideTableBit`.
+    uintptr_t bits_ = 0;
+};
+
+template <typename Derived, typename D = DefaultDelete>
+using WeakRefCounted = RefCounted<Derived, WeakCounter, D>;
+
+template <typename T>
+class IntrusiveWeakPtr {
+    template <typename Y>
+    friend class IntrusiveWeakPtr;
+
+public:
+    // Constructors
+    IntrusiveWeakPtr() : pointer_(nullptr), table_(nullptr) {
+    }
+
+    IntrusiveWeakPtr(std::nullptr_t) : pointer_(nullptr), table_(nullptr) {
+    }
+
+    template <typename Y>
+    IntrusiveWeakPtr(const IntrusivePtr<Y>& other)
+            : pointer_(other.Get()), table_(pointer_ ? pointer_->GetSideTable() : nullptr) {
+        AddWeak();
+    }
+
+    template <typename Y>
+    IntrusiveWeakPtr(const IntrusiveWeakPtr<Y>& other)
+            : pointer_(other.pointer_), table_(other.table_) {
+        AddWeak();
+    }
+
+    template <typename Y>
+    IntrusiveWeakPtr(IntrusiveWeakPtr<Y>&& other) noexcept
+            : pointer_(other.pointer_), table_(other.table_) {
+        other.pointer_ = nullptr;
+        other.table_ = nullptr;
+    }
+
+    IntrusiveWeakPtr(const IntrusiveWeakPtr& other)
+            : pointer_(other.pointer_), table_(other.table_) {
+        AddWeak();
+    }
+    IntrusiveWeakPtr(IntrusiveWeakPtr&& other) noexcept
+            : pointer_(other.pointer_), table_(other.table_) {
+        other.pointer_ = nullptr;
+        other.table_ = nullptr;
+    }
+
+    // `operator=`-s
+    IntrusiveWeakPtr& operator=(const IntrusiveWeakPtr& other) {
+        if (this == &other) {
+            return *this;
+        }
+        DeleteWeak();
+        pointer_ = other.pointer_;
+        table_ = other.table_;
+        AddWeak();
+        return *this;
+    }
+    IntrusiveWeakPtr& operator=(IntrusiveWeakPtr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        DeleteWeak();
+        pointer_ = other.pointer_;
+        table_ = other.table_;
+        other.pointer_ = nullptr;
+        other.table_ = nullptr;
+        return *this;
+    }
+
+    // Destructor
+    ~IntrusiveWeakPtr() {
+        DeleteWeak();
+    }
+
+    // Modifiers
+    void Reset() {
+        DeleteWeak();
+        pointer_ = nullptr;
+        table_ = nullptr;
+    }
+    void Swap(IntrusiveWeakPtr& other) noexcept {
+        std::swap(pointer_, other.pointer_);
+        std::swap(table_, other.table_);
+    }
+
+    // Observers
+    size_t UseCount() const {
+        if (table_) {
+            return table_->strong_count;
+        }
+        return 0;
+    }
+
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    IntrusivePtr<T> Lock() const {
+        if (Expired()) {
+            return IntrusivePtr<T>();
+        }
+        return IntrusivePtr<T>(pointer_);
+    }
+
+private:
+    void AddWeak() {
+        if (table_) {
+            ++table_->weak_count;
+        }
+    }
+
+    void DeleteWeak() {
+        if (table_) {
+            WeakCounter::ReleaseSideTable(table_);
+        }
+    }
+
+    T* pointer_;
+    IntrusiveSideTable* table_;
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Owns an object of some class derived from `Base` with value semantics: copies clone the
+// derived object, like C++26 `std::polymorphic`. Objects of up to `InlineSize` bytes with
+// noexcept moves live inside the value; others are allocated. Moves never throw and leave the
+// source empty.
+template <typename Base, size_t InlineSize = 4 * sizeof(void*)>
+class PolymorphicValue {
+    enum class Operation { kCopy, kMove, kDestroy };
+
+    // Returns the `Base` subobject of the new copy for `kCopy` and `kMove`.
+    using Manager = Base* (*)(Operation operation, PolymorphicValue* self,
+                              PolymorphicValue* destination);
+
+    template <typename Derived>
+    static constexpr bool kFitsInline = sizeof(Derived) <= InlineSize &&
+                                        alignof(Derived) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<Derived>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    PolymorphicValue() requires std::default_initializable<Base> && std::copy_constructible<Base>
+            : PolymorphicValue(std::in_place_type<Base>) {
+    }
+
+    template <typename Derived, typename... Args>
+    explicit PolymorphicValue(std::in_place_type_t<Derived>, Args&&... args) {
+        static_assert(std::derived_from<Derived, Base>);
+        static_assert(std::copy_constructible<Derived>, "copies clone the derived object");
+        if constexpr (kFitsInline<Derived>) {
+            pointer_ = std::construct_at(static_cast<Derived*>(static_cast<void*>(buffer_)),
+                                         std::forward<Args>(args)...);
+        } else {
+            pointer_ = new Derived(std::forward<Args>(args)...);
+        }
+        manager_ = &Manage<Derived>;
+    }
+
+    template <typename Derived>
+    requires(!std::same_as<std::remove_cvref_t<Derived>, PolymorphicValue> &&
+             std::derived_from<std::remove_cvref_t<Derived>, Base>)
+    explicit PolymorphicValue(Derived&& value)
+            : PolymorphicValue(std::in_place_type<std::remove_cvref_t<Derived>>,
+                               std::forward<Derived>(value)) {
+    }
+
+    PolymorphicValue(const PolymorphicValue& other) : manager_(other.manager_) {
+        if (manager_) {
+            pointer_ = manager_(Operation::kCopy, const_cast<PolymorphicValue*>(&other), this);
+        }
+    }
+
+    PolymorphicValue(PolymorphicValue&& other) noexcept {
+        TakeFrom(other);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    PolymorphicValue& operator=(const PolymorphicValue& other) {
+        if (this == &other) {
+            return *this;
+        }
+        PolymorphicValue copy(other);
+        Clear();
+        TakeFrom(copy);
+        return *this;
+    }
+
+    PolymorphicValue& operator=(PolymorphicValue&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        Clear();
+        TakeFrom(other);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~PolymorphicValue() {
+        Clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Swap(PolymorphicValue& other) noexcept {
+        PolymorphicValue temporary(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temporary);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    Base* Get() {
+        return pointer_;
+    }
+
+    const Base* Get() const {
+        return pointer_;
+    }
+
+    Base& operator*() {
+        return *pointer_;
+    }
+
+    const Base& operator*() const {
+        return *pointer_;
+    }
+
+    Base* operator->() {
+        return pointer_;
+    }
+
+    const Base* operator->() const {
+        return pointer_;
+    }
+
+    // False only for a moved-from value.
+    explicit operator bool() const {
+        return pointer_;
+    }
+
+    // Whether the object lives inside this value rather than on the heap.
+    bool IsInline() const {
+        auto address = reinterpret_cast<uintptr_t>(pointer_);
+        auto begin = reinterpret_cast<uintptr_t>(buffer_);
+        return address >= begin && address < begin + InlineSize;
+    }
+
+private:
+    template <typename Derived>
+    static Derived* Stored(PolymorphicValue* self) {
+        return static_cast<Derived*>(self->pointer_);
+    }
+
+    template <typename Derived>
+    static Base* Manage(Operation operation, PolymorphicValue* self,
+                        PolymorphicValue* destination) {
+        if constexpr (kFitsInline<Derived>) {
+            void* storage = destination ? destination->buffer_ : nullptr;
+            switch (operation) {
+                case Operation::kCopy:
+                    return std::construct_at(static_cast<Derived*>(storage),
+                                             *Stored<Derived>(self));
+                case Operation::kMove: {
+                    Base* moved = std::construct_at(static_cast<Derived*>(storage),
+                                                    std::move(*Stored<Derived>(self)));
+                    std::destroy_at(Stored<Derived>(self));
+                    return moved;
+                }
+                case Operation::kDestroy:
+                    std::destroy_at(Stored<Derived>(self));
+                    return nullptr;
+            }
+        } else {
+            switch (operation) {
+                case Operation::kCopy:
+                    return new Derived(*Stored<Derived>(self));
+                case Operation::kMove:
+                    return self->pointer_;
+                case Operation::kDestroy:
+                    delete Stored<Derived>(self);
+                    return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // Moves the object of `other` into this empty value and leaves `other` empty.
+    void TakeFrom(PolymorphicValue& other) noexcept {
+        manager_ = std::exchange(other.manager_, nullptr);
+        if (manager_) {
+            pointer_ = manager_(Operation::kMove, &other, this);
+        }
+        other.pointer_ = nullptr;
+    }
+
+    void Clear() noexcept {
+        if (manager_) {
+            manager_(Operation::kDestroy, this, nullptr);
+        }
+        manager_ = nullptr;
+        pointer_ = nullptr;
+    }
+
+    Base* pointer_ = nullptr;
+    Manager manager_ = nullptr;
+    alignas(std::max_align_t) std::byte buffer_[InlineSize];
+};
+
+template <typename Base, typename Derived = Base, typename... Args>
+PolymorphicValue<Base> MakePolymorphic(Args&&... args) {
+    return PolymorphicValue<Base>(std::in_place_type<Derived>, std::forward<Args>(args)...);
+}
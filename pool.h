@@ -0,0 +1,147 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Per-thread free lists of raw storage for objects of type `T`. Slots are exactly what
+// `new T` would allocate, so pooled objects may still be released with `delete` and vice versa.
+template <typename T>
+class ObjectPool {
+    static_assert(sizeof(T) >= sizeof(void*), "a free slot must hold the next-slot link");
+
+public:
+    static constexpr size_t kDefaultMaxCached = 1024;
+
+    template <typename... Args>
+    static T* New(Args&&... args) {
+        void* memory = Allocate();
+        T* object = nullptr;
+        SMART_PTRS_TRY {
+            object = new (memory) T(std::forward<Args>(args)...);
+        } SMART_PTRS_CATCH_ALL {
+            Deallocate(memory);
+            SMART_PTRS_RETHROW;
+        }
+        return object;
+    }
+
+    static void Delete(T* object) {
+        object->~T();
+        Deallocate(object);
+    }
+
+    static void* Allocate() {
+        auto& list = Local();
+        if (!list.head) {
+            return AllocateRaw();
+        }
+        auto slot = list.head;
+        list.head = slot->next;
+        --list.size;
+        return slot;
+    }
+
+    static void Deallocate(void* memory) {
+        auto& list = Local();
+        if (list.dead || list.size >= max_cached_.load(std::memory_order_relaxed)) {
+            DeallocateRaw(memory);
+            return;
+        }
+        if (!list.drain_registered) {
+            thread_local Drain drain;
+            list.drain_registered = true;
+        }
+        list.head = new (memory) FreeSlot{list.head};
+        ++list.size;
+    }
+
+    // Caps the number of idle slots each thread keeps; the rest go back to the allocator.
+    static void SetMaxCached(size_t count) {
+        max_cached_.store(count, std::memory_order_relaxed);
+    }
+
+    // Idle slots of the calling thread.
+    static size_t Cached() {
+        return Local().size;
+    }
+
+    // Returns idle slots of the calling thread to the allocator, keeping at most `keep`.
+    static void Trim(size_t keep = 0) {
+        auto& list = Local();
+        while (list.size > keep) {
+            auto slot = list.head;
+            list.head = slot->next;
+            --list.size;
+            DeallocateRaw(slot);
+        }
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    // Trivially destructible, so it stays usable while the thread's destructors run, and
+    // after: objects released from those (or from globals, on the main thread) still find it.
+    struct FreeList {
+        FreeSlot* head = nullptr;
+        size_t size = 0;
+        // Set once `Drain` has run; the thread caches nothing from then on.
+        bool dead = false;
+        bool drain_registered = false;
+    };
+
+    // Registered with the first cached slot; empties the list when the thread exits.
+    struct Drain {
+        ~Drain() {
+            Trim();
+            Local().dead = true;
+        }
+    };
+
+    static FreeList& Local() {
+        thread_local constinit FreeList list;
+        return list;
+    }
+
+    static void* AllocateRaw() {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(sizeof(T), std::align_val_t(alignof(T)));
+        } else {
+            return ::operator new(sizeof(T));
+        }
+    }
+
+    static void DeallocateRaw(void* memory) {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(memory, std::align_val_t(alignof(T)));
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    static inline std::atomic<size_t> max_cached_ = kDefaultMaxCached;
+};
+
+// Deleter policy for `RefCounted`: the last `DecRef` returns the memory to the
+// calling thread's `ObjectPool` instead of freeing it.
+struct PoolDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        ObjectPool<T>::Delete(object);
+    }
+};
+
+struct PooledTag {};
+
+inline constexpr PooledTag kPooled{};
+
+// `MakeIntrusive<T>(kPooled, args...)` takes the storage from `ObjectPool<T>`.
+template <typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusive(PooledTag, Args&&... args) {
+    return IntrusivePtr<T>(ObjectPool<T>::New(std::forward<Args>(args)...));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "unique.h"
+#include "unique_buffer.h"
+
+#include <cstddef>
+
+#ifdef SMART_PTRS_HAS_MMAP
+#include <sys/types.h>
+#include <unistd.h>
+
+// File descriptor stored by value, with -1 as the null handle.
+class FdHandle {
+public:
+    FdHandle() = default;
+
+    FdHandle(std::nullptr_t) {
+    }
+
+    FdHandle(int fd) : fd_(fd) {
+    }
+
+    int Get() const {
+        return fd_;
+    }
+
+    explicit operator bool() const {
+        return fd_ != -1;
+    }
+
+    friend bool operator==(FdHandle left, FdHandle right) = default;
+
+private:
+    int fd_ = -1;
+};
+
+// `UniquePtr<int, FdCloser>` holds the descriptor itself; nothing is allocated.
+struct FdCloser {
+    using pointer = FdHandle;
+
+    void operator()(FdHandle fd) const noexcept {
+        close(fd.Get());
+    }
+};
+
+using UniqueFd = UniquePtr<int, FdCloser>;
+
+// Maps `length` bytes of `fd` and unmaps them on destruction. Empty if `mmap` fails, with
+// `errno` left as set by the call.
+inline UniquePtr<std::byte[], MunmapDeleter> MapFile(int fd, size_t length, int prot = PROT_READ,
+                                                     int flags = MAP_SHARED, off_t offset = 0) {
+    void* address = mmap(nullptr, length, prot, flags, fd, offset);
+    if (address == MAP_FAILED) {
+        return UniquePtr<std::byte[], MunmapDeleter>();
+    }
+    return UniquePtr<std::byte[], MunmapDeleter>(static_cast<std::byte*>(address),
+                                                 MunmapDeleter(length));
+}
+#endif
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "intrusive.h"
+#include "shared.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>  // std::atexit
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Background thread that runs destructors handed off by latency-sensitive threads. Producers
+// push onto a lock-free stack; the reclaimer takes the whole stack at once and runs it oldest
+// first. Once `MaxPending()` jobs are waiting, `TryDefer` refuses and the caller destroys
+// inline, so a burst cannot grow the backlog without bound.
+//
+// Deferred objects carry their own `Hook`, so queueing never allocates.
+//
+// Reference counts are not atomic: a deferred object must not own references that other
+// threads still use, since its destructor drops them on the reclaimer thread.
+class Reclaimer {
+public:
+    // Queue link embedded in every deferred object.
+    struct Hook {
+        void (*job)(Hook* hook) = nullptr;
+        Hook* next = nullptr;
+    };
+
+    using Job = void (*)(Hook* hook);
+
+    static constexpr size_t kDefaultMaxPending = 4096;
+
+    explicit Reclaimer(size_t max_pending = kDefaultMaxPending)
+            : max_pending_(max_pending), worker_([this] { Run(); }) {
+    }
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    ~Reclaimer() {
+        Stop();
+    }
+
+    // The instance used by `MakeSharedDeferred` and `DeferredDelete`. It is never destroyed,
+    // so globals destroyed after it can still call `TryDefer`; an `atexit` hook stops it
+    // instead, after which such late calls are refused and the objects destroyed inline.
+    static Reclaimer& Default() {
+        static Reclaimer& reclaimer = MakeDefault();
+        return reclaimer;
+    }
+
+    // Stops the thread, then closes the queue and runs what is left on it here. Producers
+    // racing with the close either got in before it or are refused, as is every later
+    // `TryDefer`. Runs once; later calls do nothing.
+    void Stop() {
+        if (!worker_.joinable()) {
+            return;
+        }
+        stopping_.store(true, std::memory_order_release);
+        Wake();
+        worker_.join();
+        RunBatch(head_.exchange(Closed(), std::memory_order_acquire));
+    }
+
+    // Queues `job(hook)`. Returns false, without queueing, when the backlog is full or the
+    // reclaimer is shutting down; the caller is expected to run the job itself.
+    bool TryDefer(Hook* hook, Job job) {
+        if (pending_.fetch_add(1, std::memory_order_relaxed) >= MaxPending()) {
+            Finish();
+            return false;
+        }
+        // Numbered before it is pushed, so that everything `Flush` waits for runs no later than
+        // the job that completes its count.
+        enqueued_.fetch_add(1, std::memory_order_release);
+        hook->job = job;
+        Hook* head = head_.load(std::memory_order_relaxed);
+        do {
+            if (head == Closed()) {
+                Finish();
+                Complete(1);
+                return false;
+            }
+            hook->next = head;
+        } while (!head_.compare_exchange_weak(head, hook, std::memory_order_release,
+                                              std::memory_order_relaxed));
+        Wake();
+        return true;
+    }
+
+    // Blocks until every job queued so far has run; jobs queued meanwhile are not waited for.
+    // Must not be called from a deferred job.
+    void Flush() {
+        uint64_t target = enqueued_.load(std::memory_order_acquire);
+        uint64_t completed;
+        while ((completed = completed_.load(std::memory_order_acquire)) < target) {
+            completed_.wait(completed, std::memory_order_acquire);
+        }
+    }
+
+    // Jobs queued and not yet finished.
+    size_t Pending() const {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+    size_t MaxPending() const {
+        return max_pending_.load(std::memory_order_relaxed);
+    }
+
+    void SetMaxPending(size_t count) {
+        max_pending_.store(count, std::memory_order_relaxed);
+    }
+
+private:
+    static Reclaimer& MakeDefault() {
+        auto reclaimer = new Reclaimer;
+        std::atexit([] { Default().Stop(); });
+        return *reclaimer;
+    }
+
+    // Head value of a closed queue.
+    Hook* Closed() {
+        return &closed_;
+    }
+
+    void Wake() {
+        epoch_.fetch_add(1, std::memory_order_release);
+        epoch_.notify_one();
+    }
+
+    void Finish() {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Jobs run in the order they were pushed, so the count only ever covers a prefix of them.
+    void Complete(uint64_t count) {
+        completed_.fetch_add(count, std::memory_order_release);
+        completed_.notify_all();
+    }
+
+    void Run() {
+        while (true) {
+            uint32_t epoch = epoch_.load(std::memory_order_acquire);
+            Hook* batch = head_.exchange(nullptr, std::memory_order_acquire);
+            if (!batch) {
+                if (stopping_.load(std::memory_order_acquire)) {
+                    return;
+                }
+                epoch_.wait(epoch, std::memory_order_acquire);
+                continue;
+            }
+            RunBatch(batch);
+        }
+    }
+
+    // The stack holds the newest job first.
+    void RunBatch(Hook* batch) {
+        Hook* oldest = nullptr;
+        while (batch) {
+            Hook* next = batch->next;
+            batch->next = oldest;
+            oldest = batch;
+            batch = next;
+        }
+        uint64_t count = 0;
+        while (oldest) {
+            Hook* next = oldest->next;
+            oldest->job(oldest);
+            oldest = next;
+            Finish();
+            ++count;
+        }
+        if (count) {
+            Complete(count);
+        }
+    }
+
+    std::atomic<Hook*> head_ = nullptr;
+    std::atomic<size_t> pending_ = 0;
+    std::atomic<uint64_t> enqueued_ = 0;
+    std::atomic<uint64_t> completed_ = 0;
+    std::atomic<size_t> max_pending_;
+    std::atomic<uint32_t> epoch_ = 0;
+    std::atomic<bool> stopping_ = false;
+    Hook closed_;
+    std::thread worker_;
+};
+
+// `MakeShared` block whose last owner hands the object's destruction, and the block's own
+// deallocation, to `Reclaimer::Default()`. Objects still observed by a `WeakPtr` are destroyed
+// inline as usual; only the hand-off with no observers left is deferred.
+// `EnableSharedFromThis` types are rejected, since their own `WeakPtr` always observes them.
+template <typename T>
+struct ControlBlockDeferred : public ControlBlockEmplace<T>, public Reclaimer::Hook {
+    using ControlBlockEmplace<T>::ControlBlockEmplace;
+
+    ControlBlock& DeleterPointer() override {
+        if (this->Unobserved()) {
+            // `ReleaseLastStrong` calls `Deallocate` next, which takes the object along.
+            destroy_on_deallocate_ = true;
+            return *this;
+        }
+        return ControlBlockEmplace<T>::DeleterPointer();
+    }
+
+    void Deallocate() override {
+        if (!destroy_on_deallocate_) {
+            delete this;
+            return;
+        }
+        if (!Reclaimer::Default().TryDefer(this, &Reclaim)) {
+            Reclaim(this);
+        }
+    }
+
+    static void Reclaim(Reclaimer::Hook* hook) {
+        auto block = static_cast<ControlBlockDeferred*>(hook);
+        block->ControlBlockEmplace<T>::DeleterPointer();
+        delete block;
+    }
+
+    bool destroy_on_deallocate_ = false;
+};
+
+template <typename T, typename... Args>
+SharedPtr<T> MakeSharedDeferred(Args&&... args) {
+    static_assert(!EmbedsControlBlock<T>, "use DeferredDelete as the object's deleter instead");
+    // The object's own `weak_this_` would keep every such block observed, so its destruction
+    // would never be deferred.
+    static_assert(!std::is_convertible_v<T*, EnableSharedFromThisBase*>,
+                  "EnableSharedFromThis objects cannot be deferred");
+    ControlBlockEmplace<T>* block = new ControlBlockDeferred<T>(std::forward<Args>(args)...);
+    return SharedPtr<T>(block);
+}
+
+// Deleter policy for `RefCounted`: the last `DecRef` queues `Inner::Destroy` on
+// `Reclaimer::Default()`, falling back to destroying inline when the backlog is full.
+// The object must derive from `Reclaimer::Hook`.
+template <typename Inner = DefaultDelete>
+struct DeferredDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        static_assert(std::is_base_of_v<Reclaimer::Hook, T>, "T must derive Reclaimer::Hook");
+        if (!Reclaimer::Default().TryDefer(object, &Reclaim<T>)) {
+            Inner::Destroy(object);
+        }
+    }
+
+private:
+    template <typename T>
+    static void Reclaim(Reclaimer::Hook* hook) {
+        Inner::Destroy(static_cast<T*>(hook));
+    }
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "intrusive.h"
+#include "shared.h"
+#include "weak.h"
+
+#include <cstddef>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+// Batched teardown of large pointer tables. Counts are updated in one tight loop that
+// prefetches the control blocks (or intrusive objects) a few elements ahead; disposals
+// found on the way run in a second pass, so the loop is bound by bandwidth, not latency.
+// Every pointer is left empty.
+struct BatchRelease {
+    static constexpr ptrdiff_t kPrefetchDistance = 8;
+
+    static void Prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address, 1);
+#else
+        (void)address;
+#endif
+    }
+
+    // The first pass parks each pending disposal in the front of the table itself, at or
+    // behind the slot being read, so nothing is allocated and nothing can throw between
+    // dropping a reference and disposing of it. The second pass empties those slots.
+    template <typename T>
+    static void Release(SharedPtr<T>* first, SharedPtr<T>* last) {
+        ptrdiff_t size = last - first;
+        ptrdiff_t released = 0;
+        for (ptrdiff_t i = 0; i < size; ++i) {
+            if (i + kPrefetchDistance < size) {
+                Prefetch(first[i + kPrefetchDistance].block_);
+            }
+            ControlBlock* block = std::exchange(first[i].block_, nullptr);
+            first[i].pointer_ = nullptr;
+            if (DropStrong(block)) {
+                first[released++].block_ = block;
+            }
+        }
+        for (ptrdiff_t i = 0; i < released; ++i) {
+            Dispose(std::exchange(first[i].block_, nullptr));
+        }
+    }
+
+    // Drops one strong reference per entry of a plain array of control blocks (nulls allowed).
+    // Pending disposals are parked in the array the same way, so it is left with unspecified
+    // contents.
+    static void ReleaseBlocks(ControlBlock** first, ControlBlock** last) {
+        ptrdiff_t size = last - first;
+        ptrdiff_t released = 0;
+        for (ptrdiff_t i = 0; i < size; ++i) {
+            if (i + kPrefetchDistance < size && first[i + kPrefetchDistance]) {
+                Prefetch(first[i + kPrefetchDistance]);
+            }
+            ControlBlock* block = first[i];
+            if (DropStrong(block)) {
+                first[released++] = block;
+            }
+        }
+        for (ptrdiff_t i = 0; i < released; ++i) {
+            Dispose(first[i]);
+        }
+    }
+
+    template <typename T>
+    static void Release(WeakPtr<T>* first, WeakPtr<T>* last) {
+        ptrdiff_t size = last - first;
+        ptrdiff_t released = 0;
+        for (ptrdiff_t i = 0; i < size; ++i) {
+            if (i + kPrefetchDistance < size) {
+                Prefetch(first[i + kPrefetchDistance].block_);
+            }
+            ControlBlock* block = std::exchange(first[i].block_, nullptr);
+            first[i].pointer_ = nullptr;
+            if (!block) {
+                continue;
+            }
+            --block->weak_count;
+            if (block->Unobserved() && block->strong_count == 0) {
+                // Same exception as `WeakPtr::DeleteWeak`.
+                if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
+                    if (block->alive) {
+                        continue;
+                    }
+                }
+                first[released++].block_ = block;
+            }
+        }
+        for (ptrdiff_t i = 0; i < released; ++i) {
+            std::exchange(first[i].block_, nullptr)->Deallocate();
+        }
+    }
+
+    template <typename T>
+    static void Release(IntrusivePtr<T>* first, IntrusivePtr<T>* last) {
+        ptrdiff_t size = last - first;
+        ptrdiff_t released = 0;
+        for (ptrdiff_t i = 0; i < size; ++i) {
+            if (i + kPrefetchDistance < size) {
+                Prefetch(first[i + kPrefetchDistance].Get());
+            }
+            T* object = first[i].Detach();
+            if (object && object->DropRef()) {
+                // Adopted without `IncRef`; `Detach` hands it back untouched below.
+                first[released++] = IntrusivePtr<T>(object, false);
+            }
+        }
+        for (ptrdiff_t i = 0; i < released; ++i) {
+            first[i].Detach()->Dispose();
+        }
+    }
+
+private:
+    // Returns true when `block` lost its last strong reference. It is then pinned so that
+    // disposals in the second pass cannot free it early.
+    static bool DropStrong(ControlBlock* block) {
+        if (block && block->DecStrong()) {
+            ++block->weak_count;
+            return true;
+        }
+        return false;
+    }
+
+    static void Dispose(ControlBlock* block) {
+        --block->weak_count;
+        block->ReleaseLastStrong();
+    }
+};
+
+template <typename T>
+void ReleaseAll(SharedPtr<T>* first, SharedPtr<T>* last) {
+    BatchRelease::Release(first, last);
+}
+
+template <typename T>
+void ReleaseAll(WeakPtr<T>* first, WeakPtr<T>* last) {
+    BatchRelease::Release(first, last);
+}
+
+template <typename T>
+void ReleaseAll(IntrusivePtr<T>* first, IntrusivePtr<T>* last) {
+    BatchRelease::Release(first, last);
+}
+
+// `ReleaseAll(table)` for any contiguous range of pointers, e.g. `std::vector<SharedPtr<T>>`.
+template <std::ranges::contiguous_range Range>
+void ReleaseAll(Range&& range) {
+    auto first = std::ranges::data(range);
+    ReleaseAll(first, first + std::ranges::size(range));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "compressed_pair.h"
+#include "compressed_tuple.h"
+#include "intrusive.h"
+#include "intrusive_ref.h"
+#include "intrusive_weak.h"
+#include "shared.h"
+#include "shared_ref.h"
+#include "shared_view.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <cstring>  // std::memmove
+#include <memory>
+#include <type_traits>
+
+// A type is trivially relocatable when moving an object to new storage and ending the
+// lifetime of the source is equivalent to copying its bytes. None of the smart pointers
+// refer to their own address, so all of them qualify.
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+inline constexpr bool kIsTriviallyRelocatable = IsTriviallyRelocatable<T>::value;
+
+template <typename T>
+struct IsTriviallyRelocatable<SharedPtr<T>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<WeakPtr<T>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<SharedPtrView<T>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<SharedRef<T>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<IntrusivePtr<T>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<IntrusiveWeakPtr<T>> : std::true_type {};
+
+template <typename T>
+struct IsTriviallyRelocatable<IntrusiveRef<T>> : std::true_type {};
+
+template <typename T, typename Deleter>
+struct IsTriviallyRelocatable<UniquePtr<T, Deleter>>
+        : std::conjunction<IsTriviallyRelocatable<UniquePointerType<T, Deleter>>,
+                           IsTriviallyRelocatable<Deleter>> {};
+
+template <typename... Ts>
+struct IsTriviallyRelocatable<CompressedTuple<Ts...>>
+        : std::conjunction<IsTriviallyRelocatable<Ts>...> {};
+
+template <typename F, typename S>
+struct IsTriviallyRelocatable<CompressedPair<F, S>>
+        : std::conjunction<IsTriviallyRelocatable<F>, IsTriviallyRelocatable<S>> {};
+
+// Moves `[first, last)` into the uninitialized storage at `destination` and ends the lifetime
+// of the sources. Trivially relocatable types are moved with a single `memmove`.
+template <typename T>
+T* UninitializedRelocate(T* first, T* last, T* destination) noexcept(
+        kIsTriviallyRelocatable<T> || std::is_nothrow_move_constructible_v<T>) {
+    if constexpr (kIsTriviallyRelocatable<T>) {
+        auto count = last - first;
+        std::memmove(static_cast<void*>(destination), static_cast<const void*>(first),
+                     count * sizeof(T));
+        return destination + count;
+    } else {
+        for (; first != last; ++first, ++destination) {
+            std::construct_at(destination, std::move(*first));
+            std::destroy_at(first);
+        }
+        return destination;
+    }
+}
+
+template <typename T>
+T* RelocateAt(T* source, T* destination) noexcept(
+        kIsTriviallyRelocatable<T> || std::is_nothrow_move_constructible_v<T>) {
+    UninitializedRelocate(source, source + 1, destination);
+    return destination;
+}
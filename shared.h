@@ -1,9 +1,16 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
+#include "teardown.h"
+#include "unique.h"
 
+#include <cassert>
+#include <concepts>
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 
 // https://en.cppreference.com/w/cpp/memory/shared_ptr
 
@@ -13,13 +20,101 @@ template <typename T>
 class EnableSharedFromThis;
 
 struct ControlBlock {
+    // Sentinel strong count of blocks whose object is never destroyed through its pointers.
+    static constexpr size_t kImmortal = std::numeric_limits<size_t>::max();
+
+    constexpr ControlBlock() = default;
+
+    constexpr explicit ControlBlock(size_t strong) : strong_count(strong) {
+    }
+
     size_t strong_count = 1;
     size_t weak_count = 0;
     virtual ~ControlBlock() = default;
     virtual ControlBlock& DeleterPointer() {
         return *this;
     }
+    // Frees the block once both counts are zero. Blocks embedded in their object override it.
+    virtual void Deallocate() {
+        delete this;
+    }
+
+    bool IsImmortal() const {
+        return strong_count == kImmortal;
+    }
+
+    void IncStrong(size_t count = 1) {
+        if (!IsImmortal()) {
+            strong_count += count;
+        }
+    }
+
+    // Returns true when the last strong reference is gone.
+    bool DecStrong(size_t count = 1) {
+        if (IsImmortal()) {
+            return false;
+        }
+        strong_count -= count;
+        return strong_count == 0;
+    }
+
+    // Called once `DecStrong` reports the last strong reference. Runs the disposal now unless
+    // it is nested too deeply, in which case it waits on the thread's `Teardown` queue.
+    void ReleaseLastStrong() {
+        if (Teardown::TooDeep()) {
+            // Pinned so that `WeakPtr`s going away meanwhile cannot free the block early.
+            ++weak_count;
+            Teardown::Push<TeardownTraits>(this);
+            return;
+        }
+        Teardown::Scope scope;
+        ReleaseNow();
+    }
+
+    void ReleaseNow() {
+        if (alive) {
+            DeleterPointer();
+        }
+        if (Unobserved()) {
+            Deallocate();
+        }
+    }
+
+    // Nothing but strong references still needs the block: no `WeakPtr`, nor a debug-build
+    // `SharedPtrView`.
+    bool Unobserved() const {
+        return weak_count == 0 && borrow_count == 0;
+    }
+
     bool alive = true;
+    // `SharedPtrView`s of a debug build; kept apart from `weak_count` so that `IsUnique` and
+    // friends answer the same with and without NDEBUG. Fits in the padding after `alive`.
+    uint32_t borrow_count = 0;
+    // Next block on the `Teardown` queue while this one waits there.
+    ControlBlock* teardown_next = nullptr;
+
+private:
+    struct TeardownTraits {
+        static ControlBlock* Next(ControlBlock* block) {
+            return block->teardown_next;
+        }
+
+        static void SetNext(ControlBlock* block, ControlBlock* next) {
+            block->teardown_next = next;
+        }
+
+        static void Run(ControlBlock* block) {
+            --block->weak_count;
+            block->ReleaseNow();
+        }
+    };
+};
+
+// Customisation point: types that carry their own control block (e.g. `SharedRefCounted`)
+// are adopted by `SharedPtr(T*)` instead of getting a freshly allocated `ControlBlockPtr`.
+template <typename T>
+concept EmbedsControlBlock = requires(T* object) {
+    { object->GetControlBlock() } -> std::convertible_to<ControlBlock*>;
 };
 
 template <typename T>
@@ -73,6 +168,50 @@ struct ControlBlockEmplace : public ControlBlock {
     }
 };
 
+// Owns the object through the deleter it came with (see `SharedPtr(UniquePtr&&)`).
+template <typename T, typename Deleter>
+struct ControlBlockDeleter : public ControlBlock {
+    ControlBlockDeleter(T* pointer, Deleter&& deleter) : data_(pointer, std::move(deleter)) {
+    }
+
+    ControlBlock& DeleterPointer() override {
+        data_.GetSecond()(data_.GetFirst());
+        alive = false;
+        return *this;
+    }
+
+    CompressedPair<T*, Deleter> data_;
+};
+
+// Deleter of a `UniquePtr` reclaimed by `TryIntoUnique`: disposes of the object the way
+// the original control block would have, then frees the block.
+struct SharedBlockDeleter {
+    template <typename T>
+    void operator()(T* pointer) {
+        if (pointer && block) {
+            std::exchange(block, nullptr)->ReleaseLastStrong();
+        }
+    }
+
+    ControlBlock* block = nullptr;
+};
+
+// Control block for process-lifetime objects: counts never change and the object is
+// never destroyed through its pointers. Can be `constinit`, as can pointers to it.
+template <typename T>
+struct ControlBlockImmortal : public ControlBlock {
+    template <typename... Args>
+    constexpr explicit ControlBlockImmortal(Args&&... args)
+            : ControlBlock(kImmortal), object_(std::forward<Args>(args)...) {
+    }
+
+    constexpr T* GetPointer() {
+        return &object_;
+    }
+
+    T object_;
+};
+
 template <typename T>
 class SharedPtr {
 public:
@@ -82,7 +221,7 @@ public:
     SharedPtr(ControlBlock* block, T* pointer) : block_(block), pointer_(pointer) {
         if (block_) {
             if (!block_->alive) {
-                ++block_->strong_count;
+                block_->IncStrong();
             }
         }
     }
@@ -92,20 +231,24 @@ public:
         }
     }
 
+    constexpr SharedPtr(ControlBlockImmortal<T>* block)
+            : block_(block), pointer_(block->GetPointer()) {
+    }
+
     SharedPtr() : block_(nullptr), pointer_(nullptr) {
     }
 
     SharedPtr(std::nullptr_t) : block_(nullptr), pointer_(nullptr) {
     }
 
-    explicit SharedPtr(T* ptr) : block_(new ControlBlockPtr<T>(ptr)), pointer_(ptr) {
+    explicit SharedPtr(T* ptr) : block_(NewBlock(ptr)), pointer_(ptr) {
         if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
             InitWeakThis(ptr);
         }
     }
 
     template <typename Son>
-    explicit SharedPtr(Son* ptr) : block_(new ControlBlockPtr<Son>(ptr)), pointer_(ptr) {
+    explicit SharedPtr(Son* ptr) : block_(NewBlock(ptr)), pointer_(ptr) {
         if constexpr (std::is_convertible_v<Son*, EnableSharedFromThisBase*>) {
             InitWeakThis(ptr);
         }
@@ -113,24 +256,24 @@ public:
 
     SharedPtr(const SharedPtr& other) : block_(other.block_), pointer_(other.pointer_) {
         if (block_) {
-            ++block_->strong_count;
+            block_->IncStrong();
         }
     }
 
     template <typename S>
     SharedPtr(const SharedPtr<S>& other) : block_(other.block_), pointer_(other.pointer_) {
         if (block_) {
-            ++block_->strong_count;
+            block_->IncStrong();
         }
     }
 
-    SharedPtr(SharedPtr&& other) : block_(other.block_), pointer_(other.pointer_) {
+    SharedPtr(SharedPtr&& other) noexcept : block_(other.block_), pointer_(other.pointer_) {
         other.block_ = nullptr;
         other.pointer_ = nullptr;
     }
 
     template <typename Son>
-    SharedPtr(SharedPtr<Son>&& other) : block_(other.block_), pointer_(other.pointer_) {
+    SharedPtr(SharedPtr<Son>&& other) noexcept : block_(other.block_), pointer_(other.pointer_) {
         other.block_ = nullptr;
         other.pointer_ = nullptr;
     }
@@ -138,11 +281,37 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) {
-        if (other.block_) {
-            block_ = other.block_;
-            pointer_ = ptr;
-            ++block_->strong_count;
+    SharedPtr(const SharedPtr<Y>& other, T* ptr) : block_(other.block_), pointer_(ptr) {
+        if (block_) {
+            block_->IncStrong();
+        }
+    }
+
+    // Takes over the reference of `other` instead of adding one
+    template <typename Y>
+    SharedPtr(SharedPtr<Y>&& other, T* ptr) noexcept : block_(other.block_), pointer_(ptr) {
+        other.block_ = nullptr;
+        other.pointer_ = nullptr;
+    }
+
+    // Moves the deleter of `other` into the new control block. An object with an embedded
+    // block is adopted instead and later destroyed by its own policy, so only `DefaultDeleter`
+    // can be handed over.
+    template <typename Son, typename Deleter>
+    SharedPtr(UniquePtr<Son, Deleter>&& other) : block_(nullptr), pointer_(other.Get()) {
+        if (pointer_) {
+            Son* raw = other.Get();
+            if constexpr (EmbedsControlBlock<Son>) {
+                static_assert(std::is_same_v<Deleter, DefaultDeleter<Son>>,
+                              "an embedded control block disposes of the object itself");
+                block_ = NewBlock(raw);
+            } else {
+                block_ = new ControlBlockDeleter<Son, Deleter>(raw, std::move(other.GetDeleter()));
+            }
+            other.Release();
+            if constexpr (std::is_convertible_v<Son*, EnableSharedFromThisBase*>) {
+                InitWeakThis(raw);
+            }
         }
     }
 
@@ -151,9 +320,9 @@ public:
     explicit SharedPtr(const WeakPtr<T>& other) : block_(other.block_), pointer_(other.pointer_) {
         if (block_) {
             if (block_->strong_count == 0) {
-                throw BadWeakPtr();
+                ThrowOrAbort(BadWeakPtr());
             }
-            ++block_->strong_count;
+            block_->IncStrong();
         }
     }
 
@@ -168,12 +337,12 @@ public:
         block_ = other.block_;
         pointer_ = other.pointer_;
         if (block_) {
-            ++block_->strong_count;
+            block_->IncStrong();
         }
         return *this;
     }
 
-    SharedPtr& operator=(SharedPtr&& other) {
+    SharedPtr& operator=(SharedPtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
@@ -202,17 +371,17 @@ public:
     }
     void Reset(T* ptr) {
         DeleteBlock();
-        block_ = new ControlBlockPtr<T>(ptr);
+        block_ = NewBlock(ptr);
         pointer_ = ptr;
     }
     template <class Son>
     void Reset(Son* ptr) {
         DeleteBlock();
-        block_ = new ControlBlockPtr<Son>(ptr);
+        block_ = NewBlock(ptr);
         pointer_ = ptr;
     }
 
-    void Swap(SharedPtr& other) {
+    void Swap(SharedPtr& other) noexcept {
         std::swap(pointer_, other.pointer_);
         std::swap(block_, other.block_);
     }
@@ -242,18 +411,97 @@ public:
         return pointer_;
     }
 
+    // No other strong or weak reference can observe the object.
+    bool IsUnique() const {
+        return block_ && pointer_ && block_->strong_count == 1 && block_->weak_count == 0;
+    }
+
+    // Like `IsUnique`, but the object's own `EnableSharedFromThis` reference is not counted:
+    // only code that already has the object can turn it into another owner.
+    bool IsSoleOwner() const {
+        if (!block_ || !pointer_ || block_->strong_count != 1) {
+            return false;
+        }
+        if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
+            return block_->weak_count == (ObservesItself(pointer_) ? 1 : 0);
+        }
+        return block_->weak_count == 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Bulk operations
+
+    // Writes `count` copies to `out` with a single update of the strong count. If writing to
+    // `out` throws, the references not yet written are given back.
+    template <typename OutputIt>
+    OutputIt ShareN(OutputIt out, size_t count) const {
+        if (block_ && count) {
+            block_->IncStrong(count);
+        }
+        SMART_PTRS_TRY {
+            for (; count; ++out) {
+                SharedPtr copy = Adopt(block_, pointer_);
+                --count;
+                *out = std::move(copy);
+            }
+        } SMART_PTRS_CATCH_ALL {
+            // `*this` still holds a reference, so this cannot be the last one.
+            if (block_ && count) {
+                block_->DecStrong(count);
+            }
+            SMART_PTRS_RETHROW;
+        }
+        return out;
+    }
+
+    // Empties every pointer in `[first, last)`, which must all share one control block
+    // (or be empty), dropping their references with a single update of the strong count.
+    template <typename ForwardIt>
+    static void ReleaseMany(ForwardIt first, ForwardIt last) {
+        ControlBlock* block = nullptr;
+        size_t count = 0;
+        for (; first != last; ++first) {
+            SharedPtr& pointer = *first;
+            if (pointer.block_) {
+                assert((!block || block == pointer.block_) && "ReleaseMany over different objects");
+                block = pointer.block_;
+                ++count;
+            }
+            pointer.block_ = nullptr;
+            pointer.pointer_ = nullptr;
+        }
+        if (block && block->DecStrong(count)) {
+            block->ReleaseLastStrong();
+        }
+    }
+
 private:
+    // Wraps a reference the caller has already counted.
+    static SharedPtr Adopt(ControlBlock* block, T* pointer) {
+        SharedPtr shared;
+        shared.block_ = block;
+        shared.pointer_ = pointer;
+        return shared;
+    }
+
+    template <typename Son>
+    static ControlBlock* NewBlock(Son* ptr) {
+        if constexpr (EmbedsControlBlock<Son>) {
+            if (!ptr) {
+                return nullptr;
+            }
+            ControlBlock* block = ptr->GetControlBlock();
+            block->IncStrong();
+            return block;
+        } else {
+            return new ControlBlockPtr<Son>(ptr);
+        }
+    }
+
     void DeleteBlock() {
         if (block_) {
-            --block_->strong_count;
-            if (block_->strong_count == 0) {
-                if (block_->alive) {
-                    block_->DeleterPointer();
-                }
-                //                pointer_ = nullptr;
-                if (block_->weak_count == 0) {
-                    delete block_;
-                }
+            if (block_->DecStrong()) {
+                block_->ReleaseLastStrong();
             }
         }
     }
@@ -263,6 +511,11 @@ private:
         e->weak_this_ = *this;
     }
 
+    template <typename Y>
+    bool ObservesItself(const EnableSharedFromThis<Y>* e) const {
+        return e->weak_this_.block_ == block_;
+    }
+
     ControlBlock* block_;
     T* pointer_;
 
@@ -270,6 +523,18 @@ private:
     friend class SharedPtr;
     template <typename Son>
     friend class WeakPtr;
+    template <typename Son>
+    friend class SharedPtrVector;
+    friend struct BatchRelease;
+
+    template <typename Son>
+    friend UniquePtr<Son, SharedBlockDeleter> TryIntoUnique(SharedPtr<Son>&& pointer);
+    template <typename Son>
+    friend std::optional<Son> TryUnwrap(SharedPtr<Son>&& pointer);
+    template <typename Son>
+    friend class SharedPtrView;
+    template <typename Son>
+    friend class SharedRef;
 };
 
 template <typename T, typename U>
@@ -277,10 +542,93 @@ inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
     return left.Get() == right.Get();
 }
 
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+// The rvalue overloads move the control block over, leaving counts untouched.
+template <typename T, typename U>
+SharedPtr<T> StaticPointerCast(const SharedPtr<U>& pointer) {
+    return SharedPtr<T>(pointer, static_cast<T*>(pointer.Get()));
+}
+
+template <typename T, typename U>
+SharedPtr<T> StaticPointerCast(SharedPtr<U>&& pointer) {
+    auto raw = static_cast<T*>(pointer.Get());
+    return SharedPtr<T>(std::move(pointer), raw);
+}
+
+template <typename T, typename U>
+SharedPtr<T> DynamicPointerCast(const SharedPtr<U>& pointer) {
+    if (auto raw = dynamic_cast<T*>(pointer.Get())) {
+        return SharedPtr<T>(pointer, raw);
+    }
+    return SharedPtr<T>();
+}
+
+// `pointer` keeps its reference when the cast fails.
+template <typename T, typename U>
+SharedPtr<T> DynamicPointerCast(SharedPtr<U>&& pointer) {
+    if (auto raw = dynamic_cast<T*>(pointer.Get())) {
+        return SharedPtr<T>(std::move(pointer), raw);
+    }
+    return SharedPtr<T>();
+}
+
+template <typename T, typename U>
+SharedPtr<T> ConstPointerCast(const SharedPtr<U>& pointer) {
+    return SharedPtr<T>(pointer, const_cast<T*>(pointer.Get()));
+}
+
+template <typename T, typename U>
+SharedPtr<T> ConstPointerCast(SharedPtr<U>&& pointer) {
+    auto raw = const_cast<T*>(pointer.Get());
+    return SharedPtr<T>(std::move(pointer), raw);
+}
+
+template <typename T, typename U>
+SharedPtr<T> ReinterpretPointerCast(const SharedPtr<U>& pointer) {
+    return SharedPtr<T>(pointer, reinterpret_cast<T*>(pointer.Get()));
+}
+
+template <typename T, typename U>
+SharedPtr<T> ReinterpretPointerCast(SharedPtr<U>&& pointer) {
+    auto raw = reinterpret_cast<T*>(pointer.Get());
+    return SharedPtr<T>(std::move(pointer), raw);
+}
+
+// Reclaims exclusive ownership without touching the object when `pointer` holds the only
+// reference and no `WeakPtr` (including an `EnableSharedFromThis` one) observes it.
+// Otherwise returns null and leaves `pointer` as it was.
+template <typename T>
+UniquePtr<T, SharedBlockDeleter> TryIntoUnique(SharedPtr<T>&& pointer) {
+    if (!pointer.IsUnique()) {
+        return UniquePtr<T, SharedBlockDeleter>();
+    }
+    UniquePtr<T, SharedBlockDeleter> unique(pointer.pointer_, SharedBlockDeleter{pointer.block_});
+    pointer.block_ = nullptr;
+    pointer.pointer_ = nullptr;
+    return unique;
+}
+
+// Same condition as `TryIntoUnique`; moves the object out and frees its control block.
+template <typename T>
+std::optional<T> TryUnwrap(SharedPtr<T>&& pointer) {
+    if (!pointer.IsUnique()) {
+        return std::nullopt;
+    }
+    std::optional<T> value(std::move(*pointer.pointer_));
+    pointer.Reset();
+    return value;
+}
+
+// Types with an embedded control block are allocated alone, so that `SharedPtr` and
+// `IntrusivePtr` share their one count.
 template <typename T, typename... Args>
 SharedPtr<T> MakeShared(Args&&... args) {
-    auto block = new ControlBlockEmplace<T>(std::forward<Args>(args)...);
-    return SharedPtr<T>(block);
+    if constexpr (EmbedsControlBlock<T>) {
+        return SharedPtr<T>(new T(std::forward<Args>(args)...));
+    } else {
+        auto block = new ControlBlockEmplace<T>(std::forward<Args>(args)...);
+        return SharedPtr<T>(block);
+    }
 }
 
 // Look for usage examples in tests
@@ -297,6 +645,15 @@ public:
         return shared_this;
     }
 
+    // Empty instead of failing when no `SharedPtr` owns the object (any more).
+    SharedPtr<T> SharedFromThisOrNull() noexcept {
+        return weak_this_.Lock();
+    }
+
+    SharedPtr<const T> SharedFromThisOrNull() const noexcept {
+        return weak_this_.Lock();
+    }
+
     WeakPtr<T> WeakFromThis() noexcept {
         WeakPtr<T> new_weak(weak_this_);
         return new_weak;
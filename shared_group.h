@@ -0,0 +1,140 @@
+#pragma once
+
+#include "shared.h"
+
+#include <algorithm>  // std::max
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// Control block that owns `count` objects placed right after it in the same allocation.
+template <typename T>
+struct ControlBlockGroup : public ControlBlock {
+    template <typename... Args>
+    static ControlBlockGroup* Create(size_t count, const Args&... args) {
+        void* memory = ::operator new(ObjectsOffset() + count * sizeof(T),
+                                      std::align_val_t(Alignment()));
+        auto block = new (memory) ControlBlockGroup(count);
+        // Only the pointers placement `new` returns point to the objects; the storage address
+        // does not until they exist.
+        char* storage = reinterpret_cast<char*>(block) + ObjectsOffset();
+        block->objects_ = reinterpret_cast<T*>(storage);
+        size_t constructed = 0;
+        SMART_PTRS_TRY {
+            for (; constructed < count; ++constructed) {
+                T* object = new (storage + constructed * sizeof(T)) T(args...);
+                if (constructed == 0) {
+                    block->objects_ = object;
+                }
+            }
+        } SMART_PTRS_CATCH_ALL {
+            std::destroy_n(block->objects_, constructed);
+            block->~ControlBlockGroup();
+            ::operator delete(memory, std::align_val_t(Alignment()));
+            SMART_PTRS_RETHROW;
+        }
+        return block;
+    }
+
+    T* GetPointer() {
+        return objects_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    ControlBlock& DeleterPointer() override {
+        std::destroy_n(GetPointer(), size_);
+        alive = false;
+        return *this;
+    }
+
+    // Called by the deleting destructor, so `delete block_` releases the whole allocation.
+    static void operator delete(void* memory) {
+        ::operator delete(memory, std::align_val_t(Alignment()));
+    }
+
+private:
+    explicit ControlBlockGroup(size_t size) : size_(size) {
+    }
+
+    static constexpr size_t Alignment() {
+        return std::max(alignof(T), alignof(ControlBlockGroup));
+    }
+
+    static constexpr size_t ObjectsOffset() {
+        return (sizeof(ControlBlockGroup) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    size_t size_;
+    T* objects_ = nullptr;
+};
+
+// Handle to a batch of objects that share one control block. Members are handed out as
+// ordinary `SharedPtr`s through the aliasing constructor; the whole group is destroyed
+// when the handle and the last member pointer are gone.
+template <typename T>
+class SharedGroup {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedGroup() : anchor_(), size_(0) {
+    }
+
+    explicit SharedGroup(ControlBlockGroup<T>* block)
+            : anchor_(block, block->GetPointer()), size_(block->Size()) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        anchor_.Reset();
+        size_ = 0;
+    }
+
+    void Swap(SharedGroup& other) noexcept {
+        anchor_.Swap(other.anchor_);
+        std::swap(size_, other.size_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    SharedPtr<T> Share(size_t index) const {
+        return SharedPtr<T>(anchor_, anchor_.Get() + index);
+    }
+
+    T& operator[](size_t index) const {
+        return anchor_.Get()[index];
+    }
+
+    T* Data() const {
+        return anchor_.Get();
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t UseCount() const {
+        return anchor_.UseCount();
+    }
+
+    explicit operator bool() const {
+        return static_cast<bool>(anchor_);
+    }
+
+private:
+    SharedPtr<T> anchor_;
+    size_t size_;
+};
+
+// Every member is constructed from the same `args`.
+template <typename T, typename... Args>
+SharedGroup<T> MakeSharedGroup(size_t count, const Args&... args) {
+    auto block = ControlBlockGroup<T>::Create(count, args...);
+    return SharedGroup<T>(block);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "intrusive.h"
+#include "shared.h"
+
+#include <concepts>
+#include <cstddef>
+
+// Pooled objects are recycled instead of destroyed, so they must be able to forget their state.
+template <typename T>
+concept Resettable = std::default_initializable<T> && requires(T& object) { object.Reset(); };
+
+template <Resettable T>
+struct ControlBlockPooled;
+
+// Free list shared by a `SharedPool` and its outstanding blocks: whichever goes last frees it.
+template <Resettable T>
+class SharedPoolState : public SimpleRefCounted<SharedPoolState<T>> {
+public:
+    explicit SharedPoolState(size_t max_cached) : max_cached_(max_cached) {
+    }
+
+    ~SharedPoolState() {
+        Close();
+    }
+
+    // Frees the idle objects; blocks returned from now on are freed as well.
+    void Close() {
+        max_cached_ = 0;
+        while (head_) {
+            delete Pop();
+        }
+    }
+
+    ControlBlockPooled<T>* Pop() {
+        auto block = head_;
+        head_ = block->next_;
+        --size_;
+        return block;
+    }
+
+    void Push(ControlBlockPooled<T>* block) {
+        if (size_ >= max_cached_) {
+            delete block;
+            return;
+        }
+        block->next_ = head_;
+        head_ = block;
+        ++size_;
+    }
+
+    bool Empty() const {
+        return !head_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    ControlBlockPooled<T>* head_ = nullptr;
+    size_t size_ = 0;
+    size_t max_cached_;
+};
+
+// Keeps its object constructed across uses: dropping the last strong reference calls
+// `T::Reset()`, and freeing the block puts it back on the pool's free list.
+template <Resettable T>
+struct ControlBlockPooled : public ControlBlock {
+    T* GetPointer() {
+        return &object_;
+    }
+
+    ControlBlock& DeleterPointer() override {
+        object_.Reset();
+        return *this;
+    }
+
+    void Deallocate() override {
+        // The last reference to the pool may be this one; `Push` must not touch it.
+        auto pool = std::move(pool_);
+        pool->Push(this);
+    }
+
+    T object_;
+    IntrusivePtr<SharedPoolState<T>> pool_;
+    ControlBlockPooled* next_ = nullptr;
+};
+
+template <Resettable T>
+class SharedPool {
+public:
+    static constexpr size_t kDefaultMaxCached = 1024;
+
+    explicit SharedPool(size_t max_cached = kDefaultMaxCached)
+            : state_(new SharedPoolState<T>(max_cached)) {
+    }
+
+    SharedPool(const SharedPool& other) = delete;
+    SharedPool(SharedPool&& other) = default;
+    SharedPool& operator=(const SharedPool& other) = delete;
+
+    // Objects still in use outlive the pool and are freed when their last reference drops.
+    ~SharedPool() {
+        if (state_) {
+            state_->Close();
+        }
+    }
+
+    // Reuses a recycled object when there is one, otherwise constructs a new one.
+    SharedPtr<T> Acquire() {
+        ControlBlockPooled<T>* block;
+        if (state_->Empty()) {
+            block = new ControlBlockPooled<T>();
+        } else {
+            block = state_->Pop();
+            block->strong_count = 1;
+        }
+        block->pool_ = state_;
+        return SharedPtr<T>(block, block->GetPointer());
+    }
+
+    // Constructs objects up front so that the next `count` acquisitions allocate nothing.
+    void Reserve(size_t count) {
+        for (size_t cached = state_->Size(); cached < count; ++cached) {
+            auto block = new ControlBlockPooled<T>();
+            block->pool_ = state_;
+            block->Deallocate();
+        }
+    }
+
+    // Idle objects waiting for reuse.
+    size_t Cached() const {
+        return state_->Size();
+    }
+
+private:
+    IntrusivePtr<SharedPoolState<T>> state_;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+
+#include <cassert>
+#include <utility>
+
+// Non-nullable `SharedPtr`: it is only built from a non-null source, so copies, destruction
+// and dereferences never test for null. There is no moved-from state; moving copies.
+template <typename T>
+class SharedRef {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    template <typename Y>
+    explicit SharedRef(const SharedPtr<Y>& other) : block_(other.block_), pointer_(other.pointer_) {
+        assert(block_ && pointer_ && "SharedRef from a null SharedPtr");
+        block_->IncStrong();
+    }
+
+    // Takes over the reference of `other`, which is left empty.
+    template <typename Y>
+    explicit SharedRef(SharedPtr<Y>&& other) : block_(other.block_), pointer_(other.pointer_) {
+        assert(block_ && pointer_ && "SharedRef from a null SharedPtr");
+        other.block_ = nullptr;
+        other.pointer_ = nullptr;
+    }
+
+    SharedRef(const SharedRef& other) : block_(other.block_), pointer_(other.pointer_) {
+        block_->IncStrong();
+    }
+
+    template <typename Y>
+    SharedRef(const SharedRef<Y>& other) : block_(other.block_), pointer_(other.pointer_) {
+        block_->IncStrong();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    // `IncStrong` comes before `Release`, so assigning `*this` to itself never reaches zero.
+    SharedRef& operator=(const SharedRef& other) {
+        other.block_->IncStrong();
+        Release();
+        block_ = other.block_;
+        pointer_ = other.pointer_;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedRef() {
+        Release();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Swap(SharedRef& other) noexcept {
+        std::swap(block_, other.block_);
+        std::swap(pointer_, other.pointer_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return pointer_;
+    }
+
+    T& operator*() const {
+        return *pointer_;
+    }
+
+    T* operator->() const {
+        return pointer_;
+    }
+
+    size_t UseCount() const {
+        return block_->strong_count;
+    }
+
+    SharedPtr<T> ToShared() const {
+        SharedPtr<T> shared;
+        shared.block_ = block_;
+        shared.pointer_ = pointer_;
+        block_->IncStrong();
+        return shared;
+    }
+
+private:
+    void Release() {
+        if (block_->DecStrong()) {
+            block_->ReleaseLastStrong();
+        }
+    }
+
+    ControlBlock* block_;
+    T* pointer_;
+
+    template <typename Y>
+    friend class SharedRef;
+};
+
+template <typename T, typename U>
+inline bool operator==(const SharedRef<T>& left, const SharedRef<U>& right) {
+    return left.Get() == right.Get();
+}
+
+template <typename T, typename... Args>
+SharedRef<T> MakeSharedRef(Args&&... args) {
+    return SharedRef<T>(MakeShared<T>(std::forward<Args>(args)...));
+}
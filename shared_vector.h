@@ -0,0 +1,288 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "release.h"
+#include "shared.h"
+
+#include <bit>  // std::countr_zero, std::popcount
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// x86-64 builds carry an AVX2 version of the scans whatever the compiler flags, and pick it at
+// run time when the CPU supports it.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define SMART_PTRS_AVX2_SCANS 1
+#endif
+
+// Array of `SharedPtr<T>` stored column-wise: object pointers and control blocks live in
+// separate arrays, so scans over the objects read only the half they need. Each element owns
+// one strong reference; element access hands out ordinary `SharedPtr<T>`s.
+template <typename T>
+class SharedPtrVector {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedPtrVector() = default;
+
+    SharedPtrVector(const SharedPtrVector& other)
+            : objects_(other.objects_), blocks_(other.blocks_) {
+        for (auto block : blocks_) {
+            if (block) {
+                block->IncStrong();
+            }
+        }
+    }
+
+    SharedPtrVector(SharedPtrVector&& other) noexcept = default;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SharedPtrVector& operator=(const SharedPtrVector& other) {
+        if (this == &other) {
+            return *this;
+        }
+        SharedPtrVector copy(other);
+        Swap(copy);
+        return *this;
+    }
+
+    SharedPtrVector& operator=(SharedPtrVector&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        Clear();
+        objects_ = std::move(other.objects_);
+        blocks_ = std::move(other.blocks_);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedPtrVector() {
+        Clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void PushBack(const SharedPtr<T>& pointer) {
+        MakeRoom();
+        objects_.push_back(pointer.pointer_);
+        blocks_.push_back(pointer.block_);
+        if (pointer.block_) {
+            pointer.block_->IncStrong();
+        }
+    }
+
+    void PushBack(SharedPtr<T>&& pointer) {
+        MakeRoom();
+        objects_.push_back(pointer.pointer_);
+        blocks_.push_back(pointer.block_);
+        pointer.block_ = nullptr;
+        pointer.pointer_ = nullptr;
+    }
+
+    void PopBack() {
+        ReleaseBlock(blocks_.back());
+        objects_.pop_back();
+        blocks_.pop_back();
+    }
+
+    void Set(size_t index, SharedPtr<T> pointer) {
+        std::swap(objects_[index], pointer.pointer_);
+        std::swap(blocks_[index], pointer.block_);
+    }
+
+    void Reserve(size_t capacity) {
+        objects_.reserve(capacity);
+        blocks_.reserve(capacity);
+    }
+
+    // Drops every reference with the prefetching two-pass loop of `ReleaseAll`. Allocates
+    // nothing, so the destructor and move assignment can use it.
+    void Clear() {
+        BatchRelease::ReleaseBlocks(blocks_.data(), blocks_.data() + blocks_.size());
+        objects_.clear();
+        blocks_.clear();
+    }
+
+    // Removes null elements, keeping the order of the rest.
+    void Compact() {
+        size_t size = Size();
+        size_t out = FindNull();
+        for (size_t i = out; i < size; ++i) {
+            if (objects_[i]) {
+                objects_[out] = objects_[i];
+                blocks_[out] = blocks_[i];
+                ++out;
+            } else {
+                ReleaseBlock(blocks_[i]);
+            }
+        }
+        objects_.resize(out);
+        blocks_.resize(out);
+    }
+
+    void Swap(SharedPtrVector& other) noexcept {
+        objects_.swap(other.objects_);
+        blocks_.swap(other.blocks_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    SharedPtr<T> operator[](size_t index) const {
+        return SharedPtr<T>::Adopt(AddRef(blocks_[index]), objects_[index]);
+    }
+
+    // The raw object pointer, without touching any count.
+    T* Get(size_t index) const {
+        return objects_[index];
+    }
+
+    T* const* Data() const {
+        return objects_.data();
+    }
+
+    size_t Size() const {
+        return objects_.size();
+    }
+
+    bool Empty() const {
+        return objects_.empty();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Scans over the object column
+
+    // Index of the first element pointing to `object`, or `Size()`.
+    size_t Find(const T* object) const {
+        return FindPointer(objects_.data(), objects_.size(), object);
+    }
+
+    size_t FindNull() const {
+        return Find(nullptr);
+    }
+
+    size_t CountNull() const {
+        return CountPointer(objects_.data(), objects_.size(), nullptr);
+    }
+
+private:
+    // Grows both columns before either is pushed to, so a `bad_alloc` leaves them the same
+    // length and the pushes that follow cannot throw.
+    void MakeRoom() {
+        size_t size = Size();
+        size_t capacity = size ? 2 * size : 1;
+        if (objects_.capacity() == size) {
+            objects_.reserve(capacity);
+        }
+        if (blocks_.capacity() == size) {
+            blocks_.reserve(capacity);
+        }
+    }
+
+    static ControlBlock* AddRef(ControlBlock* block) {
+        if (block) {
+            block->IncStrong();
+        }
+        return block;
+    }
+
+    static void ReleaseBlock(ControlBlock* block) {
+        if (block && block->DecStrong()) {
+            block->ReleaseLastStrong();
+        }
+    }
+
+    static size_t FindPointer(T* const* data, size_t size, const T* value) {
+#ifdef SMART_PTRS_AVX2_SCANS
+        if (HasAvx2()) {
+            return FindPointerAvx2(data, size, value);
+        }
+#endif
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i] == value) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    static size_t CountPointer(T* const* data, size_t size, const T* value) {
+#ifdef SMART_PTRS_AVX2_SCANS
+        if (HasAvx2()) {
+            return CountPointerAvx2(data, size, value);
+        }
+#endif
+        size_t count = 0;
+        for (size_t i = 0; i < size; ++i) {
+            count += data[i] == value;
+        }
+        return count;
+    }
+
+#ifdef SMART_PTRS_AVX2_SCANS
+    static bool HasAvx2() {
+#ifdef __AVX2__
+        return true;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    // Compare four pointers per instruction; the tails fall back to plain loops.
+    [[gnu::target("avx2")]] static size_t FindPointerAvx2(T* const* data, size_t size,
+                                                          const T* value) {
+        const __m256i needle = Broadcast(value);
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            if (unsigned mask = EqualMask(Load(data + i), needle)) {
+                return i + std::countr_zero(mask);
+            }
+        }
+        for (; i < size; ++i) {
+            if (data[i] == value) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    [[gnu::target("avx2")]] static size_t CountPointerAvx2(T* const* data, size_t size,
+                                                           const T* value) {
+        const __m256i needle = Broadcast(value);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            count += std::popcount(EqualMask(Load(data + i), needle));
+        }
+        for (; i < size; ++i) {
+            count += data[i] == value;
+        }
+        return count;
+    }
+
+    [[gnu::target("avx2")]] static __m256i Broadcast(const T* pointer) {
+        return _mm256_set1_epi64x(static_cast<int64_t>(reinterpret_cast<uintptr_t>(pointer)));
+    }
+
+    [[gnu::target("avx2")]] static __m256i Load(T* const* data) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    }
+
+    // One bit per 64-bit lane that compares equal.
+    [[gnu::target("avx2")]] static unsigned EqualMask(__m256i left, __m256i right) {
+        return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(left, right)));
+    }
+#endif
+
+    std::vector<T*> objects_;
+    std::vector<ControlBlock*> blocks_;
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+
+#include <cassert>
+#include <cstddef>  // std::nullptr_t
+#include <utility>
+
+// Non-owning borrow of a `SharedPtr`: passing or copying it never touches the counts.
+// The owner must outlive the view; `Upgrade` takes a real reference when the callee keeps it.
+// Debug builds keep the control block allocated through its `borrow_count` and assert on use
+// after the last owner is gone.
+template <typename T>
+class SharedPtrView {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedPtrView() : block_(nullptr), pointer_(nullptr) {
+    }
+
+    SharedPtrView(std::nullptr_t) : block_(nullptr), pointer_(nullptr) {
+    }
+
+    template <typename Y>
+    SharedPtrView(const SharedPtr<Y>& owner) : block_(owner.block_), pointer_(owner.pointer_) {
+        Pin();
+    }
+
+    // A temporary owner would be gone before the view is used.
+    template <typename Y>
+    SharedPtrView(SharedPtr<Y>&&) = delete;
+
+    SharedPtrView(const SharedPtrView& other) : block_(other.block_), pointer_(other.pointer_) {
+        Pin();
+    }
+
+    template <typename Y>
+    SharedPtrView(const SharedPtrView<Y>& other) : block_(other.block_), pointer_(other.pointer_) {
+        Pin();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SharedPtrView& operator=(const SharedPtrView& other) {
+        if (this == &other) {
+            return *this;
+        }
+        Unpin();
+        block_ = other.block_;
+        pointer_ = other.pointer_;
+        Pin();
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedPtrView() {
+        Unpin();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        CheckOwner();
+        return pointer_;
+    }
+
+    T& operator*() const {
+        CheckOwner();
+        return *pointer_;
+    }
+
+    T* operator->() const {
+        CheckOwner();
+        return pointer_;
+    }
+
+    explicit operator bool() const {
+        return pointer_;
+    }
+
+    // Shares ownership with the borrowed pointer.
+    SharedPtr<T> Upgrade() const {
+        CheckOwner();
+        SharedPtr<T> shared;
+        shared.block_ = block_;
+        shared.pointer_ = pointer_;
+        if (block_) {
+            block_->IncStrong();
+        }
+        return shared;
+    }
+
+private:
+#ifdef NDEBUG
+    void Pin() {
+    }
+
+    void Unpin() {
+    }
+
+    void CheckOwner() const {
+    }
+#else
+    void Pin() {
+        if (block_) {
+            ++block_->borrow_count;
+        }
+    }
+
+    void Unpin() {
+        if (block_) {
+            --block_->borrow_count;
+            if (block_->Unobserved() && block_->strong_count == 0) {
+                block_->Deallocate();
+            }
+        }
+    }
+
+    void CheckOwner() const {
+        assert((!block_ || block_->strong_count > 0) && "SharedPtrView outlived its owner");
+    }
+#endif
+
+    ControlBlock* block_;
+    T* pointer_;
+
+    template <typename Y>
+    friend class SharedPtrView;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "exceptions.h"
+
 #include <exception>
 
 class BadWeakPtr : public std::exception {};
@@ -9,3 +11,12 @@ class SharedPtr;
 
 template <typename T>
 class WeakPtr;
+
+template <typename T>
+class SharedPtrView;
+
+template <typename T>
+class SharedRef;
+
+template <typename T>
+class SharedPtrVector;
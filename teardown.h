@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-thread "destruction in progress" bookkeeping. Last-reference disposals nest (a list
+// node destroys its `next` pointer) and run synchronously up to `kMaxDepth` levels, so shallow
+// graphs are destroyed in the usual order. Past that depth a disposal is queued instead, and
+// the outermost disposal runs the queue once it returns, so a chain of any length takes
+// bounded stack.
+//
+// Queued objects are linked through storage they no longer need (a dead count, say), so the
+// queue never allocates. All state is trivially destructible and stays usable while statics
+// are destroyed at exit.
+//
+// `Traits` describe one kind of queued object:
+//     static Node* Next(Node* node);
+//     static void SetNext(Node* node, Node* next);
+//     static void Run(Node* node);  // The deferred disposal.
+class Teardown {
+public:
+    static constexpr size_t kMaxDepth = 64;
+
+    // Marks one disposal in progress; the outermost one runs the queue when it ends.
+    class Scope {
+    public:
+        Scope() {
+            ++Local().depth;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            auto& state = Local();
+            if (--state.depth == 0 && !state.draining) {
+                Drain(state);
+            }
+        }
+    };
+
+    // Whether a new disposal is too deeply nested to run now and should be pushed instead.
+    static bool TooDeep() {
+        return Local().depth >= kMaxDepth;
+    }
+
+    template <typename Traits, typename Node>
+    static void Push(Node* node) {
+        auto& list = TypedList<Traits, Node>::Local();
+        Traits::SetNext(node, list.head);
+        list.head = node;
+        if (!list.queued) {
+            auto& state = Local();
+            list.queued = true;
+            list.next = state.lists;
+            state.lists = &list;
+        }
+    }
+
+private:
+    // A per-type list of queued objects, itself linked into the thread's set of non-empty lists.
+    struct List {
+        // Runs one queued object; false if the list is empty.
+        bool (*run_one)(List* list);
+        List* next = nullptr;
+        bool queued = false;
+    };
+
+    template <typename Traits, typename Node>
+    struct TypedList : List {
+        static TypedList& Local() {
+            thread_local constinit TypedList list{{&RunOne}};
+            return list;
+        }
+
+        static bool RunOne(List* list) {
+            auto& self = static_cast<TypedList&>(*list);
+            Node* node = self.head;
+            if (!node) {
+                return false;
+            }
+            self.head = Traits::Next(node);
+            Traits::Run(node);
+            return true;
+        }
+
+        Node* head = nullptr;
+    };
+
+    struct State {
+        size_t depth = 0;
+        bool draining = false;
+        List* lists = nullptr;
+    };
+
+    static State& Local() {
+        thread_local constinit State state;
+        return state;
+    }
+
+    // Queued disposals run at depth 0 and may nest (and queue) again in turn. New lists are
+    // linked in at the front, so an empty front list can be unlinked right away.
+    static void Drain(State& state) {
+        state.draining = true;
+        while (List* list = state.lists) {
+            if (!list->run_one(list)) {
+                state.lists = list->next;
+                list->queued = false;
+            }
+        }
+        state.draining = false;
+    }
+};
@@ -0,0 +1,972 @@
+// Builds every header of the library and runs the behaviours that need a real program to
+// show: deep teardown, destruction order, and the cases fixed after review.
+
+#include "../any_deleter.h"
+#include "../compressed_pair.h"
+#include "../compressed_tuple.h"
+#include "../cow.h"
+#include "../exceptions.h"
+#include "../intrusive.h"
+#include "../intrusive_ref.h"
+#include "../intrusive_weak.h"
+#include "../polymorphic.h"
+#include "../pool.h"
+#include "../posix_handles.h"
+#include "../reclaimer.h"
+#include "../release.h"
+#include "../relocate.h"
+#include "../shared.h"
+#include "../shared_group.h"
+#include "../shared_pool.h"
+#include "../shared_ref.h"
+#include "../shared_vector.h"
+#include "../shared_view.h"
+#include "../teardown.h"
+#include "../unique.h"
+#include "../unique_buffer.h"
+#include "../weak.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                             \
+            std::exit(1);                                                         \
+        }                                                                         \
+    } while (false)
+
+constexpr size_t kLongChain = 1'000'000;
+
+// Both `UniquePtr`s have a real move constructor, which `trivial_abi` needs (unique.h checks
+// the attribute itself on compilers that support it).
+static_assert(std::is_nothrow_move_constructible_v<UniquePtr<int>>);
+static_assert(std::is_nothrow_move_constructible_v<UniquePtr<int[]>>);
+static_assert(kIsTriviallyRelocatable<UniquePtr<int>>);
+
+struct SharedNode {
+    SharedPtr<SharedNode> next;
+};
+
+struct IntrusiveNode : SimpleRefCounted<IntrusiveNode> {
+    IntrusivePtr<IntrusiveNode> next;
+};
+
+struct WeakNode : WeakRefCounted<WeakNode> {
+    IntrusivePtr<WeakNode> next;
+};
+
+struct EmbeddedNode : SharedRefCounted<EmbeddedNode> {
+    IntrusivePtr<EmbeddedNode> next;
+};
+
+// A chain far deeper than the stack could take recursively.
+void TestLongSharedChain() {
+    SharedPtr<SharedNode> head;
+    for (size_t i = 0; i < kLongChain; ++i) {
+        auto node = MakeShared<SharedNode>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    WeakPtr<SharedNode> first(head);
+    head.Reset();
+    CHECK(first.Expired());
+}
+
+template <typename Node>
+void TestLongIntrusiveChain() {
+    IntrusivePtr<Node> head;
+    for (size_t i = 0; i < kLongChain; ++i) {
+        auto node = MakeIntrusive<Node>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    head.Reset();
+}
+
+// `IntrusiveWeakPtr`s into a long chain expire once it is gone.
+void TestLongWeakChain() {
+    IntrusivePtr<WeakNode> head;
+    std::vector<IntrusiveWeakPtr<WeakNode>> observers;
+    for (size_t i = 0; i < kLongChain; ++i) {
+        auto node = MakeIntrusive<WeakNode>();
+        node->next = std::move(head);
+        head = std::move(node);
+        if (i % 1000 == 0) {
+            observers.emplace_back(head);
+        }
+    }
+    head.Reset();
+    for (const auto& observer : observers) {
+        CHECK(observer.Expired());
+    }
+}
+
+// Shallow graphs keep the usual order: a member is destroyed before the members declared
+// above it, so a child may still use its parent's state.
+struct Parent;
+
+struct Child {
+    ~Child();
+
+    Parent* parent;
+};
+
+struct Parent {
+    std::vector<int> registry{1, 2, 3};
+    SharedPtr<Child> child;
+};
+
+Child::~Child() {
+    CHECK(parent->registry.size() == 3);
+}
+
+void TestShallowOrder() {
+    auto parent = MakeShared<Parent>();
+    parent->child = MakeShared<Child>(parent.Get());
+    parent.Reset();
+}
+
+// A global list is destroyed after thread-local state at exit; its teardown must not rely on it.
+SharedPtr<SharedNode> global_list;
+
+void TestGlobalChain() {
+    for (size_t i = 0; i < 10'000; ++i) {
+        auto node = MakeShared<SharedNode>();
+        node->next = std::move(global_list);
+        global_list = std::move(node);
+    }
+}
+
+// The first disposal drops the only `WeakPtr` to the second object, which `ReleaseAll` has
+// already counted down and must keep alive until its own turn.
+struct Observer : SharedRefCounted<Observer> {
+    WeakPtr<Observer> w;
+};
+
+void TestReleaseAllWeakOrder() {
+    std::vector<IntrusivePtr<Observer>> table;
+    table.push_back(MakeIntrusive<Observer>());
+    table.push_back(MakeIntrusive<Observer>());
+    table[0]->w = ToShared(table[1]);
+    ReleaseAll(table);
+    CHECK(!table[0] && !table[1]);
+}
+
+// Every way into a `SharedPtr` adopts the embedded count rather than allocating a second one.
+void TestEmbeddedBlockAdopted() {
+    auto made = MakeShared<EmbeddedNode>();
+    IntrusivePtr<EmbeddedNode> intrusive(made.Get());
+    CHECK(made.UseCount() == 2 && intrusive.UseCount() == 2);
+
+    SharedPtr<EmbeddedNode> converted(UniquePtr<EmbeddedNode>(new EmbeddedNode));
+    IntrusivePtr<EmbeddedNode> other(converted.Get());
+    CHECK(converted.UseCount() == 2);
+}
+
+struct Counted {
+    ~Counted() {
+        ++destroyed;
+    }
+
+    static inline std::atomic<size_t> destroyed = 0;
+};
+
+struct DeferredNode : Reclaimer::Hook, SimpleRefCounted<DeferredNode, DeferredDelete<>> {
+    Counted counted;
+};
+
+// Constructed before the default reclaimer exists and destroyed after it has stopped: the
+// hand-off is refused and the object destroyed inline.
+SharedPtr<Counted> global_deferred;
+
+void TestDeferredDestruction() {
+    global_deferred = MakeSharedDeferred<Counted>();
+    Counted::destroyed = 0;
+    {
+        auto shared = MakeSharedDeferred<Counted>();
+        auto intrusive = MakeIntrusive<DeferredNode>();
+    }
+    Reclaimer::Default().Flush();
+    CHECK(Counted::destroyed == 2);
+}
+
+// Jobs still queued when the reclaimer goes away run exactly once, and later ones are refused.
+void TestReclaimerShutdown() {
+    constexpr size_t kJobs = 10'000;
+    struct Job : Reclaimer::Hook {
+        static void Run(Reclaimer::Hook* hook) {
+            ++static_cast<Job*>(hook)->runs;
+        }
+
+        std::atomic<int> runs = 0;
+    };
+    std::vector<Job> jobs(kJobs);
+    {
+        Reclaimer reclaimer(kJobs);
+        std::thread producer([&] {
+            for (auto& job : jobs) {
+                if (!reclaimer.TryDefer(&job, &Job::Run)) {
+                    Job::Run(&job);
+                }
+            }
+        });
+        producer.join();
+    }
+    for (const auto& job : jobs) {
+        CHECK(job.runs == 1);
+    }
+}
+
+struct SelfAware : EnableSharedFromThis<SelfAware> {
+    int value = 0;
+};
+
+// The object's own weak reference does not make a sole owner clone.
+void TestCowSelfReference() {
+    auto cow = MakeCow<SelfAware>();
+    const SelfAware* original = cow.Get();
+    cow.Mutate().value = 1;
+    CHECK(cow.Get() == original);
+
+    WeakPtr<const SelfAware> observer = cow->WeakFromThis();
+    cow.Mutate().value = 2;
+    CHECK(cow.Get() != original && cow->value == 2 && observer.Expired());
+}
+
+// A view is not an observer: uniqueness checks answer the same in debug and release builds.
+void TestViewKeepsUniqueness() {
+    static_assert(std::is_constructible_v<SharedPtrView<const int>, SharedPtr<int>&>);
+    static_assert(!std::is_constructible_v<SharedPtrView<const int>, SharedPtr<int>>);
+    auto owner = MakeShared<int>(1);
+    SharedPtrView<int> view(owner);
+    CHECK(owner.IsUnique() && *view == 1);
+    auto value = TryUnwrap(std::move(owner));
+    CHECK(value && *value == 1);
+}
+
+// Scans agree with a plain loop on every length around the four-pointer chunks, and clearing
+// releases every element.
+void TestSharedVectorScans() {
+    Counted::destroyed = 0;
+    {
+        SharedPtrVector<Counted> vector;
+        for (size_t i = 0; i < 11; ++i) {
+            vector.PushBack(i % 3 ? MakeShared<Counted>() : SharedPtr<Counted>());
+        }
+        CHECK(vector.FindNull() == 0 && vector.CountNull() == 4);
+        CHECK(vector.Find(vector.Get(10)) == 10);
+        vector.Compact();
+        CHECK(vector.Size() == 7 && vector.CountNull() == 0 && vector.FindNull() == 7);
+        SharedPtrVector<Counted> other = vector;
+        vector = std::move(other);
+    }
+    CHECK(Counted::destroyed == 7);
+}
+
+// `Flush` waits for the jobs queued before it, not for the queue to run dry.
+void TestReclaimerFlushUnderLoad() {
+    struct Job : Reclaimer::Hook {
+        static void Run(Reclaimer::Hook* hook) {
+            delete static_cast<Job*>(hook);
+        }
+    };
+    struct Marker : Reclaimer::Hook {
+        static void Run(Reclaimer::Hook* hook) {
+            static_cast<Marker*>(hook)->ran = true;
+        }
+
+        std::atomic<bool> ran = false;
+    };
+    Reclaimer reclaimer(size_t(1) << 20);
+    std::atomic<bool> stop = false;
+    std::thread producer([&] {
+        while (!stop) {
+            auto job = new Job;
+            if (!reclaimer.TryDefer(job, &Job::Run)) {
+                Job::Run(job);
+            }
+        }
+    });
+    Marker marker;
+    CHECK(reclaimer.TryDefer(&marker, &Marker::Run));
+    reclaimer.Flush();
+    CHECK(marker.ran);
+    stop = true;
+    producer.join();
+}
+
+struct Pooled : SimpleRefCounted<Pooled, PoolDelete> {
+    size_t payload[4] = {};
+};
+
+// Released at exit, after the main thread's free list has been drained: freed directly.
+IntrusivePtr<Pooled> global_pooled;
+
+// A thread's cached slots are freed when it exits.
+void TestPoolThreadExit() {
+    global_pooled = MakeIntrusive<Pooled>(kPooled);
+    std::thread worker([] {
+        MakeIntrusive<Pooled>(kPooled).Reset();
+        CHECK(ObjectPool<Pooled>::Cached() == 1);
+    });
+    worker.join();
+}
+
+// A byte count that does not fit in `size_t` is refused rather than wrapped around.
+void TestBufferSizeOverflow() {
+#ifndef SMART_PTRS_NO_EXCEPTIONS
+    bool thrown = false;
+    try {
+        MakeUniqueForOverwrite<uint64_t[]>(SIZE_MAX / 4);
+    } catch (const std::bad_array_new_length&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+#endif
+}
+
+// Output iterator that accepts `limit` writes into `sink`, then throws.
+template <typename Pointer>
+struct ThrowingOutput {
+    ThrowingOutput& operator*() {
+        return *this;
+    }
+
+    ThrowingOutput& operator++() {
+        return *this;
+    }
+
+    ThrowingOutput& operator=(Pointer&& pointer) {
+        if (sink->size() == limit) {
+            throw std::bad_alloc();
+        }
+        sink->push_back(std::move(pointer));
+        return *this;
+    }
+
+    std::vector<Pointer>* sink;
+    size_t limit;
+};
+
+// References `ShareN` could not write are given back.
+void TestShareNThrows() {
+#ifndef SMART_PTRS_NO_EXCEPTIONS
+    auto shared = MakeShared<int>(1);
+    std::vector<SharedPtr<int>> shared_sink;
+    try {
+        shared.ShareN(ThrowingOutput<SharedPtr<int>>{&shared_sink, 3}, 10);
+    } catch (const std::bad_alloc&) {
+    }
+    CHECK(shared.UseCount() == 4);
+
+    auto intrusive = MakeIntrusive<IntrusiveNode>();
+    std::vector<IntrusivePtr<IntrusiveNode>> intrusive_sink;
+    try {
+        intrusive.ShareN(ThrowingOutput<IntrusivePtr<IntrusiveNode>>{&intrusive_sink, 3}, 10);
+    } catch (const std::bad_alloc&) {
+    }
+    CHECK(intrusive.UseCount() == 4);
+#endif
+}
+
+// Every overload empties the whole table and disposes of each object exactly once.
+void TestReleaseAllTables() {
+    Counted::destroyed = 0;
+    auto kept = MakeShared<Counted>();
+    std::vector<SharedPtr<Counted>> shared;
+    std::vector<WeakPtr<Counted>> weak;
+    for (size_t i = 0; i < 20; ++i) {
+        shared.push_back(i % 4 == 0 ? SharedPtr<Counted>() : MakeShared<Counted>());
+        weak.emplace_back(i % 2 ? shared.back() : kept);
+    }
+    shared.push_back(kept);
+    ReleaseAll(shared);
+    CHECK(Counted::destroyed == 15 && kept.UseCount() == 1);
+    for (const auto& pointer : shared) {
+        CHECK(!pointer);
+    }
+    ReleaseAll(weak);
+    for (const auto& pointer : weak) {
+        CHECK(pointer.Expired());
+    }
+}
+
+// One control block keeps every member alive after the handle is gone, and the last member
+// pointer frees all of them together.
+void TestSharedGroup() {
+    Counted::destroyed = 0;
+    auto group = MakeSharedGroup<Counted>(5);
+    CHECK(group.Size() == 5 && group.UseCount() == 1);
+    auto third = group.Share(2);
+    auto last = group.Share(4);
+    CHECK(group.UseCount() == 3 && third.Get() == &group[2]);
+    group.Reset();
+    CHECK(!group && Counted::destroyed == 0 && third.UseCount() == 2);
+    third.Reset();
+    CHECK(Counted::destroyed == 0);
+    last.Reset();
+    CHECK(Counted::destroyed == 5);
+
+    auto strings = MakeSharedGroup<std::string>(3, std::string(100, 'x'));
+    auto member = strings.Share(1);
+    strings.Reset();
+    CHECK(member->size() == 100);
+}
+
+struct Eternal : SimpleRefCounted<Eternal> {
+    constexpr Eternal() = default;
+
+    ~Eternal() {
+        ++destroyed;
+    }
+
+    static inline size_t destroyed = 0;
+};
+
+constinit ControlBlockImmortal<Eternal> eternal_block;
+constinit SharedPtr<Eternal> eternal_shared(&eternal_block);
+constinit Immortal<Eternal> eternal_object;
+constinit IntrusivePtr<Eternal> eternal_intrusive(&eternal_object);
+
+// Copies and resets of pointers to immortal objects leave the count alone and never destroy.
+void TestImmortal() {
+    CHECK(eternal_shared.UseCount() == ControlBlock::kImmortal);
+    {
+        std::vector<SharedPtr<Eternal>> copies(10, eternal_shared);
+        copies.front().Reset();
+        WeakPtr<Eternal> weak(eternal_shared);
+        CHECK(!weak.Expired());
+    }
+    CHECK(eternal_shared.UseCount() == ControlBlock::kImmortal);
+
+    CHECK(eternal_intrusive.UseCount() == SimpleCounter::kImmortal);
+    {
+        std::vector<IntrusivePtr<Eternal>> copies(10, eternal_intrusive);
+        copies.front().Reset();
+        IntrusivePtr<Eternal> adopted(&eternal_object, true);
+    }
+    CHECK(eternal_intrusive.UseCount() == SimpleCounter::kImmortal);
+    CHECK(eternal_object.IsImmortal() && Eternal::destroyed == 0);
+}
+
+struct Watched : WeakRefCounted<Watched> {
+    Counted counted;
+};
+
+void TestIntrusiveWeak() {
+    Counted::destroyed = 0;
+    auto strong = MakeIntrusive<Watched>();
+    IntrusiveWeakPtr<Watched> weak(strong);
+    // Later weak pointers share the side table the first one created.
+    IntrusiveWeakPtr<Watched> second(strong);
+    CHECK(strong->GetSideTable() == strong->GetSideTable());
+    CHECK(strong.UseCount() == 1 && weak.UseCount() == 1);
+    {
+        auto locked = weak.Lock();
+        CHECK(locked.Get() == strong.Get() && strong.UseCount() == 2);
+    }
+
+    // The object dies first; the side table stays for the weak pointers still holding it.
+    strong.Reset();
+    CHECK(Counted::destroyed == 1 && weak.Expired() && !weak.Lock());
+    IntrusiveWeakPtr<Watched> copy = second;
+    second.Reset();
+    weak.Reset();
+    CHECK(copy.Expired() && !copy.Lock());
+}
+
+// Released storage comes back for the next object, each thread keeps at most the cap, and
+// `Trim` hands everything back.
+void TestObjectPool() {
+    using Pool = ObjectPool<Pooled>;
+    Pool::Trim();
+    auto first = MakeIntrusive<Pooled>(kPooled);
+    Pooled* address = first.Get();
+    first.Reset();
+    CHECK(Pool::Cached() == 1);
+    auto second = MakeIntrusive<Pooled>(kPooled);
+    CHECK(second.Get() == address && Pool::Cached() == 0);
+    second.Reset();
+
+    Pool::SetMaxCached(3);
+    {
+        std::vector<IntrusivePtr<Pooled>> many;
+        for (size_t i = 0; i < 10; ++i) {
+            many.push_back(MakeIntrusive<Pooled>(kPooled));
+        }
+    }
+    CHECK(Pool::Cached() == 3);
+    Pool::Trim(1);
+    CHECK(Pool::Cached() == 1);
+    Pool::Trim();
+    CHECK(Pool::Cached() == 0);
+    Pool::SetMaxCached(Pool::kDefaultMaxCached);
+}
+
+struct Session {
+    void Reset() {
+        ++resets;
+        user.clear();
+    }
+
+    std::string user;
+    size_t resets = 0;
+};
+
+void TestSharedPool() {
+    SharedPool<Session> pool(2);
+    Session* address;
+    {
+        auto session = pool.Acquire();
+        session->user = "alice";
+        address = session.Get();
+    }
+    // Reset ran before the object went back on the free list.
+    CHECK(pool.Cached() == 1);
+    auto reused = pool.Acquire();
+    CHECK(reused.Get() == address && reused->user.empty() && reused->resets == 1);
+
+    pool.Reserve(5);
+    CHECK(pool.Cached() == 2);
+
+    // Outlives its pool and is freed, not recycled, when it goes.
+    SharedPtr<Session> survivor;
+    {
+        SharedPool<Session> short_lived;
+        survivor = short_lived.Acquire();
+        survivor->user = "bob";
+    }
+    CHECK(survivor->user == "bob");
+    survivor.Reset();
+}
+
+// Moving a non-nullable reference copies it, so the source stays usable.
+void TestRefs() {
+    auto shared = MakeSharedRef<int>(7);
+    CHECK(shared.UseCount() == 1);
+    SharedRef<int> moved = std::move(shared);
+    CHECK(shared.Get() && *shared == 7 && moved.Get() == shared.Get() && moved.UseCount() == 2);
+    auto as_shared = moved.ToShared();
+    CHECK(as_shared.UseCount() == 3);
+
+    auto intrusive = MakeIntrusiveRef<IntrusiveNode>();
+    CHECK(intrusive.UseCount() == 1);
+    IntrusiveRef<IntrusiveNode> moved_intrusive = std::move(intrusive);
+    CHECK(intrusive.Get() && moved_intrusive.Get() == intrusive.Get());
+    CHECK(intrusive.UseCount() == 2);
+    auto as_intrusive = intrusive.ToIntrusive();
+    CHECK(as_intrusive.UseCount() == 3);
+}
+
+struct Shape : SimpleRefCounted<Shape> {
+    virtual ~Shape() = default;
+};
+
+struct Circle : Shape {};
+
+struct Square : Shape {};
+
+// The rvalue casts reuse the reference they are given; a failed dynamic cast keeps it.
+void TestPointerCasts() {
+    SharedPtr<Shape> shared = MakeShared<Circle>();
+    auto keep = shared;
+    CHECK(keep.UseCount() == 2);
+    auto circle = StaticPointerCast<Circle>(std::move(shared));
+    CHECK(!shared && keep.UseCount() == 2);
+    SharedPtr<Shape> shape = DynamicPointerCast<Shape>(std::move(circle));
+    CHECK(!circle && keep.UseCount() == 2);
+    auto square = DynamicPointerCast<Square>(std::move(shape));
+    CHECK(!square && shape && keep.UseCount() == 2);
+    auto copied = DynamicPointerCast<Circle>(shape);
+    CHECK(copied && keep.UseCount() == 3);
+
+    IntrusivePtr<Shape> intrusive = MakeIntrusive<Circle>();
+    auto intrusive_keep = intrusive;
+    CHECK(intrusive_keep.UseCount() == 2);
+    auto intrusive_circle = StaticPointerCast<Circle>(std::move(intrusive));
+    CHECK(!intrusive && intrusive_keep.UseCount() == 2);
+    IntrusivePtr<Shape> intrusive_shape = DynamicPointerCast<Shape>(std::move(intrusive_circle));
+    CHECK(!intrusive_circle && intrusive_keep.UseCount() == 2);
+    auto intrusive_square = DynamicPointerCast<Square>(std::move(intrusive_shape));
+    CHECK(!intrusive_square && intrusive_shape && intrusive_keep.UseCount() == 2);
+}
+
+struct CountedNode : SimpleRefCounted<CountedNode> {
+    Counted counted;
+};
+
+// Copies handed out by `ShareN` are taken back by `ReleaseMany`, skipping empty slots.
+void TestShareAndReleaseMany() {
+    size_t destroyed = Counted::destroyed;
+    auto shared = MakeShared<Counted>();
+    std::vector<SharedPtr<Counted>> shared_copies(2);
+    shared.ShareN(std::back_inserter(shared_copies), 5);
+    CHECK(shared.UseCount() == 6 && shared_copies.size() == 7);
+    SharedPtr<Counted>::ReleaseMany(shared_copies.begin(), shared_copies.end());
+    CHECK(shared.UseCount() == 1 && !shared_copies[2]);
+    shared_copies.resize(3);
+    shared.ShareN(shared_copies.begin() + 1, 1);
+    shared_copies.push_back(std::move(shared));
+    SharedPtr<Counted>::ReleaseMany(shared_copies.begin(), shared_copies.end());
+    CHECK(Counted::destroyed == destroyed + 1);
+
+    auto intrusive = MakeIntrusive<CountedNode>();
+    std::vector<IntrusivePtr<CountedNode>> intrusive_copies(2);
+    intrusive.ShareN(std::back_inserter(intrusive_copies), 5);
+    CHECK(intrusive.UseCount() == 6 && intrusive_copies.size() == 7);
+    IntrusivePtr<CountedNode>::ReleaseMany(intrusive_copies.begin(), intrusive_copies.end());
+    CHECK(intrusive.UseCount() == 1 && !intrusive_copies[2]);
+    intrusive_copies.resize(3);
+    intrusive.ShareN(intrusive_copies.begin() + 1, 1);
+    intrusive_copies.push_back(std::move(intrusive));
+    IntrusivePtr<CountedNode>::ReleaseMany(intrusive_copies.begin(), intrusive_copies.end());
+    CHECK(Counted::destroyed == destroyed + 2);
+}
+
+struct CountingDelete {
+    void operator()(Counted* pointer) const {
+        ++*calls;
+        delete pointer;
+    }
+
+    int* calls;
+};
+
+// Exclusive ownership comes back only from a sole, unobserved owner.
+void TestTryIntoUnique() {
+    size_t destroyed = Counted::destroyed;
+    auto shared = MakeShared<Counted>();
+    Counted* raw = shared.Get();
+    auto second = shared;
+    CHECK(!TryIntoUnique(std::move(shared)));
+    CHECK(shared.Get() == raw && shared.UseCount() == 2);
+    second.Reset();
+    WeakPtr<Counted> weak(shared);
+    CHECK(!TryIntoUnique(std::move(shared)));
+    CHECK(shared.Get() == raw && shared.UseCount() == 1);
+    weak.Reset();
+    auto unique = TryIntoUnique(std::move(shared));
+    CHECK(unique.Get() == raw && !shared && Counted::destroyed == destroyed);
+    unique.Reset();
+    CHECK(Counted::destroyed == destroyed + 1);
+
+    auto text = MakeShared<std::string>("moved out");
+    auto other = text;
+    CHECK(!TryUnwrap(std::move(text)) && text.UseCount() == 2);
+    other.Reset();
+    auto value = TryUnwrap(std::move(text));
+    CHECK(value && *value == "moved out" && !text);
+
+    int calls = 0;
+    UniquePtr<Counted, CountingDelete> owner(new Counted, CountingDelete{&calls});
+    SharedPtr<Counted> adopted(std::move(owner));
+    auto reclaimed = TryIntoUnique(std::move(adopted));
+    CHECK(reclaimed && calls == 0);
+    reclaimed.Reset();
+    CHECK(calls == 1 && Counted::destroyed == destroyed + 2);
+}
+
+// Trivially destructible, so it can live in an aligned array; the third one throws.
+struct Fragile {
+    Fragile() {
+        if (++constructed == 3) {
+            ThrowOrAbort(std::bad_alloc());
+        }
+    }
+
+    static inline int constructed = 0;
+};
+
+void TestUniqueArrays() {
+    auto values = MakeUniqueArray<int>(5);
+    CHECK(values.Size() == 5 && values.end() - values.begin() == 5);
+    CHECK(values.AsSpan().data() == values.Get() && values.AsSpan().size() == 5);
+    values[4] = 7;
+    int sum = 0;
+    for (int value : values) {
+        sum += value;
+    }
+    CHECK(sum == 7);
+
+    auto aligned = MakeAlignedArray<float, 64>(17);
+    CHECK(reinterpret_cast<uintptr_t>(aligned.Get()) % 64 == 0 && aligned.Size() == 17);
+    CHECK(aligned.AsSpan().size() == 17 && aligned[16] == 0.0f);
+
+#ifndef SMART_PTRS_NO_EXCEPTIONS
+    bool thrown = false;
+    try {
+        MakeAlignedArray<uint64_t>(SIZE_MAX / 4);
+    } catch (const std::bad_array_new_length&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        MakeAlignedArray<Fragile>(4);
+    } catch (const std::bad_alloc&) {
+        thrown = true;
+    }
+    CHECK(thrown && Fragile::constructed == 3);
+#endif
+}
+
+// Small trivial arrays come from the heap; from the threshold on they are mapped.
+void TestBufferForOverwrite() {
+    auto small = MakeUniqueForOverwrite<uint8_t[]>(64);
+    CHECK(small && small.GetDeleter().Length() == 0);
+    small[63] = 1;
+
+    auto mapped = MakeUniqueForOverwrite<uint32_t[]>(3000, BufferOptions{.mmap_threshold = 4096});
+#ifdef SMART_PTRS_HAS_MMAP
+    CHECK(mapped.GetDeleter().Length() == 3000 * sizeof(uint32_t));
+    CHECK(mapped[2999] == 0);
+#endif
+    mapped[2999] = 7;
+    CHECK(mapped[2999] == 7);
+
+    auto below = MakeUniqueForOverwrite<uint32_t[]>(1023, BufferOptions{.mmap_threshold = 4096});
+    CHECK(below.GetDeleter().Length() == 0);
+    auto words = MakeUniqueForOverwrite<std::string[]>(3, BufferOptions{.mmap_threshold = 1});
+    CHECK(words[2].empty());
+}
+
+// The descriptor lives inside the `UniquePtr` and is closed once, by its last owner.
+void TestPosixHandles() {
+#ifdef SMART_PTRS_HAS_MMAP
+    static_assert(sizeof(UniqueFd) == sizeof(int));
+    char path[] = "/tmp/smart_ptrs_test.XXXXXX";
+    int raw = mkstemp(path);
+    CHECK(raw != -1);
+    unlink(path);
+    auto is_open = [raw] { return lseek(raw, 0, SEEK_CUR) != -1; };
+    {
+        UniqueFd fd(raw);
+        CHECK(fd.Get().Get() == raw);
+        UniqueFd moved(std::move(fd));
+        CHECK(!fd && moved.Get().Get() == raw);
+        fd.Reset();
+        CHECK(is_open());
+
+        const char text[] = "mapped contents";
+        CHECK(write(raw, text, sizeof(text)) == ssize_t(sizeof(text)));
+        auto mapped = MapFile(moved.Get().Get(), sizeof(text));
+        CHECK(mapped && mapped.GetDeleter().Length() == sizeof(text));
+        CHECK(std::string(reinterpret_cast<const char*>(mapped.Get())) == text);
+    }
+    CHECK(!is_open());
+    CHECK(!MapFile(-1, 16));
+#endif
+}
+
+// Stateful deleter that counts its calls and its live copies.
+struct TrackedDelete {
+    TrackedDelete(int* calls, int* live) : calls(calls), live(live) {
+        ++*live;
+    }
+
+    TrackedDelete(TrackedDelete&& other) noexcept : calls(other.calls), live(other.live) {
+        ++*live;
+    }
+
+    ~TrackedDelete() {
+        --*live;
+    }
+
+    void operator()(Counted* pointer) const {
+        ++*calls;
+        delete pointer;
+    }
+
+    int* calls;
+    int* live;
+};
+
+// Small deleters sit in the inline buffer; moving the erased deleter around neither
+// calls nor leaks the one it manages.
+void TestAnyDeleterStorage() {
+    static_assert(sizeof(AnyDeleter<Counted, 0>) == sizeof(void*));
+    static_assert(sizeof(AnyDeleter<Counted>) == 3 * sizeof(void*));
+    static_assert(sizeof(UniquePtr<Counted, AnyDeleter<Counted>>) == 4 * sizeof(void*));
+
+    int calls = 0;
+    int live = 0;
+    {
+        UniquePtr<Counted, AnyDeleter<Counted>> first(new Counted, TrackedDelete(&calls, &live));
+        CHECK(live == 1);
+        auto second = std::move(first);
+        UniquePtr<Counted, AnyDeleter<Counted>> third;
+        third = std::move(second);
+        first.Reset();
+        second.Reset();
+        CHECK(calls == 0 && live == 3);
+    }
+    CHECK(calls == 1 && live == 0);
+}
+
+struct Shape2D {
+    virtual ~Shape2D() = default;
+
+    virtual int Corners() const {
+        return 0;
+    }
+
+    int tag = 0;
+};
+
+// Exactly `Bytes` bytes, so it sits on either side of the inline limit.
+template <size_t Bytes>
+struct Sized : Shape2D {
+    int Corners() const override {
+        return int(Bytes);
+    }
+
+    std::byte padding[Bytes - sizeof(Shape2D)] = {};
+};
+
+struct ThrowingMove : Shape2D {
+    ThrowingMove() = default;
+    ThrowingMove(const ThrowingMove&) = default;
+    ThrowingMove(ThrowingMove&&) noexcept(false) {
+    }
+};
+
+// Copies are deep whichever storage the object uses; moves empty the source.
+void TestPolymorphicValue() {
+    using Value = PolymorphicValue<Shape2D>;
+    constexpr size_t kInline = 4 * sizeof(void*);
+    static_assert(sizeof(Sized<kInline>) == kInline);
+    static_assert(sizeof(Sized<kInline + 8>) == kInline + 8);
+
+    Value fits(std::in_place_type<Sized<kInline>>);
+    Value spills(std::in_place_type<Sized<kInline + 8>>);
+    CHECK(fits.IsInline() && !spills.IsInline());
+    CHECK(!Value(std::in_place_type<ThrowingMove>).IsInline());
+
+    for (Value* original : {&fits, &spills}) {
+        original->Get()->tag = 1;
+        Value copy(*original);
+        CHECK(copy.Get() != original->Get() && copy.IsInline() == original->IsInline());
+        CHECK(copy->Corners() == (*original)->Corners() && copy->tag == 1);
+        copy->tag = 2;
+        CHECK((*original)->tag == 1);
+
+        Value moved(std::move(copy));
+        CHECK(!copy && moved->tag == 2 && moved.IsInline() == original->IsInline());
+        copy = *original;
+        CHECK(copy && copy->tag == 1);
+        Value assigned;
+        assigned = std::move(moved);
+        CHECK(!moved && assigned->tag == 2);
+    }
+}
+
+struct EmptyTag {};
+
+struct FinalTag final {};
+
+// Empty elements, final ones included, take no space, and triviality carries over.
+void TestCompressedTuple() {
+    static_assert(sizeof(UniquePtr<int>) == sizeof(int*));
+    static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*));
+    static_assert(sizeof(CompressedTuple<int*, EmptyTag, FinalTag>) == sizeof(int*));
+    static_assert(sizeof(CompressedPair<int*, FinalTag>) == sizeof(int*));
+    static_assert(std::is_trivially_copyable_v<CompressedTuple<int*, EmptyTag, long>>);
+    static_assert(std::is_trivially_copyable_v<CompressedPair<int*, FinalTag>>);
+    static_assert(!std::is_trivially_copyable_v<CompressedTuple<int*, std::string>>);
+
+    CompressedTuple<int, EmptyTag, std::string> tuple(1, EmptyTag{}, "two");
+    auto copy = tuple;
+    copy.Get<2>() += "!";
+    CHECK(copy.Get<0>() == 1 && copy.Get<2>() == "two!" && tuple.Get<2>() == "two");
+}
+
+// Makes, moves and resets `UniquePtr`s during constant evaluation, which rejects leaks and
+// double deletes.
+constexpr int ConstexprUniqueRoundTrip() {
+    UniquePtr<int> first(new int(20));
+    UniquePtr<int> second(std::move(first));
+    *second += 1;
+    int value = first ? 0 : *second;
+    second.Reset(new int(2));
+    value *= *second;
+    first = std::move(second);
+    first.Reset();
+    UniquePtr<int[]> array(new int[3]{1, 2, 3});
+    return value + array[2] - 3;
+}
+
+void TestConstexprUnique() {
+    static_assert(ConstexprUniqueRoundTrip() == 42);
+    CHECK(ConstexprUniqueRoundTrip() == 42);
+}
+
+// The promotions that report failure instead of throwing, usable with exceptions off.
+void TestNonThrowingPromotion() {
+    WeakPtr<int> empty;
+    auto from_empty = empty.TryLock();
+    CHECK(from_empty && !*from_empty);
+
+    auto shared = MakeShared<int>(5);
+    WeakPtr<int> weak(shared);
+    auto live = weak.TryLock();
+    CHECK(live && **live == 5 && shared.UseCount() == 2);
+    live->Reset();
+    shared.Reset();
+    auto expired = weak.TryLock();
+    CHECK(!expired);
+
+    SelfAware on_stack;
+    CHECK(!on_stack.SharedFromThisOrNull() && on_stack.WeakFromThis().Expired());
+    const SelfAware& view = on_stack;
+    CHECK(!view.SharedFromThisOrNull());
+    auto owned = MakeShared<SelfAware>();
+    CHECK(owned->SharedFromThisOrNull() == owned);
+    CHECK(owned.UseCount() == 1);
+}
+
+int main() {
+    TestLongSharedChain();
+    TestLongIntrusiveChain<IntrusiveNode>();
+    TestLongIntrusiveChain<EmbeddedNode>();
+    TestLongWeakChain();
+    TestShallowOrder();
+    TestGlobalChain();
+    TestReleaseAllWeakOrder();
+    TestEmbeddedBlockAdopted();
+    TestDeferredDestruction();
+    TestReclaimerShutdown();
+    TestReclaimerFlushUnderLoad();
+    TestPoolThreadExit();
+    TestBufferSizeOverflow();
+    TestShareNThrows();
+    TestReleaseAllTables();
+    TestCowSelfReference();
+    TestViewKeepsUniqueness();
+    TestSharedVectorScans();
+    TestSharedGroup();
+    TestImmortal();
+    TestIntrusiveWeak();
+    TestObjectPool();
+    TestSharedPool();
+    TestRefs();
+    TestPointerCasts();
+    TestShareAndReleaseMany();
+    TestTryIntoUnique();
+    TestUniqueArrays();
+    TestBufferForOverwrite();
+    TestPosixHandles();
+    TestAnyDeleterStorage();
+    TestPolymorphicValue();
+    TestCompressedTuple();
+    TestConstexprUnique();
+    TestNonThrowingPromotion();
+    return 0;
+}
@@ -1,77 +1,114 @@
 #pragma once
 
 #include "compressed_pair.h"
+#include "exceptions.h"
 
+#include <cassert>
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>  // SIZE_MAX
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
 
 struct Slug {};
 
+// Build with SMART_PTRS_TRIVIAL_ABI to pass `UniquePtr` in registers where the compiler
+// supports it. This changes the calling convention, so all code must agree on the flag.
+#if defined(SMART_PTRS_TRIVIAL_ABI) && defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::trivial_abi)
+#define SMART_PTRS_TRIVIAL_ABI_ATTRIBUTE [[clang::trivial_abi]]
+#define SMART_PTRS_HAS_TRIVIAL_ABI 1
+#endif
+#endif
+#ifndef SMART_PTRS_TRIVIAL_ABI_ATTRIBUTE
+#define SMART_PTRS_TRIVIAL_ABI_ATTRIBUTE
+#endif
+
 template <typename T>
 class DefaultDeleter {
 public:
-    DefaultDeleter() = default;
+    constexpr DefaultDeleter() = default;
 
-    void operator()(T* ptr) const noexcept {
+    constexpr void operator()(T* ptr) const noexcept {
         delete ptr;
     }
 
     template <typename S>
-    DefaultDeleter(DefaultDeleter<S>&& other) {
+    constexpr DefaultDeleter(DefaultDeleter<S>&& other) {
     }
 };
 
 template <typename T>
 class DefaultDeleter<T[]> {
 public:
-    void operator()(T* ptr) const noexcept {
+    constexpr void operator()(T* ptr) const noexcept {
         delete[] ptr;
     }
 };
 
+// `Deleter::pointer` when the deleter declares one, as with `std::unique_ptr`, so handles
+// such as file descriptors can be stored inline; `T*` otherwise.
+template <typename T, typename Deleter>
+struct UniquePointer {
+    using Type = T*;
+};
+
+template <typename T, typename Deleter>
+requires requires { typename std::remove_reference_t<Deleter>::pointer; }
+struct UniquePointer<T, Deleter> {
+    using Type = typename std::remove_reference_t<Deleter>::pointer;
+};
+
+template <typename T, typename Deleter>
+using UniquePointerType = typename UniquePointer<T, Deleter>::Type;
+
 // Primary template
 template <typename T, typename Deleter = DefaultDeleter<T>>
-class UniquePtr {
+class SMART_PTRS_TRIVIAL_ABI_ATTRIBUTE UniquePtr {
 public:
+    using Pointer = UniquePointerType<T, Deleter>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    explicit UniquePtr(T* ptr = nullptr) : data_(ptr, Deleter()) {
+    constexpr explicit UniquePtr(Pointer ptr = Pointer()) : data_(ptr, Deleter()) {
     }
 
-    UniquePtr(T* ptr, const Deleter& deleter) : data_(ptr, deleter) {
+    constexpr UniquePtr(Pointer ptr, const Deleter& deleter) : data_(ptr, deleter) {
     }
 
-    UniquePtr(T* ptr, Deleter&& deleter) : data_(ptr, std::move(deleter)) {
+    constexpr UniquePtr(Pointer ptr, Deleter&& deleter) : data_(ptr, std::move(deleter)) {
     }
 
     UniquePtr(const UniquePtr& other) = delete;
 
+    // A real move constructor: the converting template below never counts as one, and
+    // `trivial_abi` is ignored on a class without a usable copy or move constructor.
+    constexpr UniquePtr(UniquePtr&& other) noexcept
+            : data_(other.Release(), std::move(other.data_.GetSecond())) {
+    }
+
     template <typename Son, typename SonDeleter>
-    UniquePtr(UniquePtr<Son, SonDeleter>&& other) noexcept
-            : data_(std::move(other.data_.GetFirst()), std::move(other.data_.GetSecond())) {
-        other.data_.GetFirst() = nullptr;
+    constexpr UniquePtr(UniquePtr<Son, SonDeleter>&& other) noexcept
+            : data_(other.Release(), std::move(other.data_.GetSecond())) {
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
-    UniquePtr& operator=(UniquePtr&& other) noexcept {
+    constexpr UniquePtr& operator=(UniquePtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
-        data_.GetSecond()(data_.GetFirst());
-        data_.GetFirst() = other.data_.GetFirst();
+        Reset(other.Release());
         data_.GetSecond() = std::move(other.data_.GetSecond());
-        other.data_.GetFirst() = nullptr;
         return *this;
     }
 
-    UniquePtr& operator=(std::nullptr_t) {
-        if (!data_.GetFirst()) {
-            return *this;
-        }
-        data_.GetSecond()(data_.GetFirst());
-        data_.GetFirst() = std::nullptr_t();
+    constexpr UniquePtr& operator=(std::nullptr_t) {
+        Reset();
         return *this;
     }
 
@@ -80,7 +117,7 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Destructor
 
-    ~UniquePtr() {
+    constexpr ~UniquePtr() {
         if (data_.GetFirst()) {
             data_.GetSecond()(data_.GetFirst());
         }
@@ -89,19 +126,21 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    T* Release() {
+    constexpr Pointer Release() {
         auto ptr = data_.GetFirst();
-        data_.GetFirst() = nullptr;
+        data_.GetFirst() = Pointer();
         return ptr;
     }
 
-    void Reset(T* ptr = nullptr) noexcept {
+    constexpr void Reset(Pointer ptr = Pointer()) noexcept {
         auto first = data_.GetFirst();
         data_.GetFirst() = ptr;
-        data_.GetSecond()(first);
+        if (first) {
+            data_.GetSecond()(first);
+        }
     }
 
-    void Swap(UniquePtr& other) {
+    constexpr void Swap(UniquePtr& other) noexcept {
         std::swap(data_.GetFirst(), other.data_.GetFirst());
         std::swap(data_.GetSecond(), other.data_.GetSecond());
     }
@@ -109,74 +148,268 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
 
-    T* Get() const {
+    constexpr Pointer Get() const {
         return data_.GetFirst();
     }
 
-    Deleter& GetDeleter() {
+    constexpr Deleter& GetDeleter() {
         return data_.GetSecond();
     }
 
-    const Deleter& GetDeleter() const {
+    constexpr const Deleter& GetDeleter() const {
         return data_.GetSecond();
     }
 
-    explicit operator bool() const {
-        return data_.GetFirst();
+    constexpr explicit operator bool() const {
+        return static_cast<bool>(data_.GetFirst());
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Single-object dereference operators
 
-    typename std::add_lvalue_reference<T>::type operator*() const {
+    constexpr typename std::add_lvalue_reference<T>::type operator*() const {
         return *data_.GetFirst();
     }
 
-    T* operator->() const {
+    constexpr Pointer operator->() const {
         return data_.GetFirst();
     }
 
 private:
-    CompressedPair<T*, Deleter> data_;
+    CompressedPair<Pointer, Deleter> data_;
     template <typename Son, typename SonDeleter>
     friend class UniquePtr;
 };
 
 // Specialization for arrays
 template <typename T, typename Deleter>
-class UniquePtr<T[], Deleter> {
+class SMART_PTRS_TRIVIAL_ABI_ATTRIBUTE UniquePtr<T[], Deleter> {
 public:
-    UniquePtr(T* ptr) : data_(ptr, Deleter()) {
+    using Pointer = UniquePointerType<T, Deleter>;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    constexpr UniquePtr(Pointer ptr = Pointer()) : data_(ptr, Deleter()) {
     }
 
-    UniquePtr(T* ptr, const Deleter& deleter) : data_(ptr, deleter) {
+    constexpr UniquePtr(Pointer ptr, const Deleter& deleter) : data_(ptr, deleter) {
     }
 
-    ~UniquePtr() {
-        data_.GetSecond()(data_.GetFirst());
+    constexpr UniquePtr(Pointer ptr, Deleter&& deleter) : data_(ptr, std::move(deleter)) {
     }
 
-    void Reset(T* ptr = nullptr) noexcept {
+    UniquePtr(const UniquePtr& other) = delete;
+
+    constexpr UniquePtr(UniquePtr&& other) noexcept
+            : data_(other.Release(), std::move(other.data_.GetSecond())) {
+    }
+
+    template <typename Son, typename SonDeleter>
+    constexpr UniquePtr(UniquePtr<Son[], SonDeleter>&& other) noexcept
+            : data_(other.Release(), std::move(other.data_.GetSecond())) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    constexpr UniquePtr& operator=(UniquePtr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        Reset(other.Release());
+        data_.GetSecond() = std::move(other.data_.GetSecond());
+        return *this;
+    }
+
+    constexpr UniquePtr& operator=(std::nullptr_t) {
+        Reset();
+        return *this;
+    }
+
+    UniquePtr& operator=(const UniquePtr& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    constexpr ~UniquePtr() {
+        if (data_.GetFirst()) {
+            data_.GetSecond()(data_.GetFirst());
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    constexpr Pointer Release() {
+        auto ptr = data_.GetFirst();
+        data_.GetFirst() = Pointer();
+        return ptr;
+    }
+
+    constexpr void Reset(Pointer ptr = Pointer()) noexcept {
         auto first = data_.GetFirst();
         data_.GetFirst() = ptr;
-        data_.GetSecond()(first);
+        if (first) {
+            data_.GetSecond()(first);
+        }
     }
 
-    T& operator[](size_t position) {
-        return *(data_.GetFirst() + position);
+    constexpr void Swap(UniquePtr& other) noexcept {
+        std::swap(data_.GetFirst(), other.data_.GetFirst());
+        std::swap(data_.GetSecond(), other.data_.GetSecond());
     }
 
-    UniquePtr(T* ptr, Deleter&& deleter) : data_(ptr, std::move(deleter)) {
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    constexpr Pointer Get() const {
+        return data_.GetFirst();
     }
 
-    UniquePtr(const UniquePtr& other) = delete;
+    constexpr Deleter& GetDeleter() {
+        return data_.GetSecond();
+    }
 
+    constexpr const Deleter& GetDeleter() const {
+        return data_.GetSecond();
+    }
+
+    constexpr explicit operator bool() const {
+        return static_cast<bool>(data_.GetFirst());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Array element access
+
+    constexpr T& operator[](size_t position) const {
+        return data_.GetFirst()[position];
+    }
+
+private:
+    CompressedPair<Pointer, Deleter> data_;
     template <typename Son, typename SonDeleter>
-    UniquePtr(UniquePtr<Son[], SonDeleter>&& other) noexcept
-            : data_(std::move(other.data_.GetFirst()), other.data_.GetSecond()) {
-        other.data_.GetFirst() = nullptr;
+    friend class UniquePtr;
+};
+
+// The compiler drops `trivial_abi` silently when the class does not qualify; make sure it took.
+#if defined(SMART_PTRS_HAS_TRIVIAL_ABI) && defined(__has_builtin)
+#if __has_builtin(__is_trivially_relocatable)
+static_assert(__is_trivially_relocatable(UniquePtr<int>), "trivial_abi was not applied");
+static_assert(__is_trivially_relocatable(UniquePtr<int[]>), "trivial_abi was not applied");
+#endif
+#endif
+
+// Frees arrays made by `MakeAlignedArray`. Elements are trivially destructible, so no
+// length is needed and the deleter stays empty.
+template <typename T, size_t Alignment>
+struct AlignedArrayDeleter {
+    static_assert(std::is_trivially_destructible_v<T>, "aligned arrays skip element destructors");
+
+    void operator()(T* ptr) const noexcept {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+};
+
+// Array that knows its length. Element access is bounds-checked in debug builds only.
+template <typename T, typename Deleter = DefaultDeleter<T[]>>
+class UniqueArray {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    UniqueArray() : data_(), size_(0) {
+    }
+
+    UniqueArray(UniquePtr<T[], Deleter>&& data, size_t size) : data_(std::move(data)), size_(size) {
+    }
+
+    UniqueArray(UniqueArray&& other) noexcept
+            : data_(std::move(other.data_)), size_(std::exchange(other.size_, 0)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    UniqueArray& operator=(UniqueArray&& other) noexcept {
+        data_ = std::move(other.data_);
+        size_ = std::exchange(other.size_, 0);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    T* Release() {
+        size_ = 0;
+        return data_.Release();
+    }
+
+    void Reset() {
+        data_.Reset();
+        size_ = 0;
+    }
+
+    void Swap(UniqueArray& other) noexcept {
+        data_.Swap(other.data_);
+        std::swap(size_, other.size_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return data_.Get();
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    std::span<T> AsSpan() const {
+        return std::span<T>(data_.Get(), size_);
+    }
+
+    T* begin() const {
+        return data_.Get();
+    }
+
+    T* end() const {
+        return data_.Get() + size_;
+    }
+
+    explicit operator bool() const {
+        return static_cast<bool>(data_);
+    }
+
+    T& operator[](size_t position) const {
+        assert(position < size_ && "UniqueArray index out of range");
+        return data_[position];
     }
 
 private:
-    CompressedPair<T*, Deleter> data_;
+    UniquePtr<T[], Deleter> data_;
+    size_t size_;
 };
+
+// Value-initialised array of `size` elements.
+template <typename T>
+UniqueArray<T> MakeUniqueArray(size_t size) {
+    return UniqueArray<T>(UniquePtr<T[]>(new T[size]()), size);
+}
+
+// Value-initialised array whose storage starts on an `Alignment`-byte boundary, so vector
+// kernels can use aligned loads (32 for AVX, 64 for AVX-512 and cache lines).
+template <typename T, size_t Alignment = 64>
+UniqueArray<T, AlignedArrayDeleter<T, Alignment>> MakeAlignedArray(size_t size) {
+    static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0);
+    if (size > SIZE_MAX / sizeof(T)) {
+        ThrowOrAbort(std::bad_array_new_length());
+    }
+    // Owned before construction starts, so a throwing constructor does not leak the storage;
+    // the deleter skips destructors, which are trivial.
+    UniquePtr<T[], AlignedArrayDeleter<T, Alignment>> data(
+            static_cast<T*>(::operator new(size * sizeof(T), std::align_val_t(Alignment))));
+    std::uninitialized_value_construct_n(data.Get(), size);
+    return UniqueArray<T, AlignedArrayDeleter<T, Alignment>>(std::move(data), size);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "exceptions.h"
+#include "unique.h"
+
+#include <cstddef>
+#include <cstdint>  // SIZE_MAX
+#include <new>  // std::bad_alloc, std::bad_array_new_length
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define SMART_PTRS_HAS_MMAP 1
+#endif
+
+// Single object left default-initialised: no zeroing for trivial types.
+template <typename T>
+requires(!std::is_array_v<T>)
+UniquePtr<T> MakeUniqueForOverwrite() {
+    return UniquePtr<T>(new T);
+}
+
+struct BufferOptions {
+    // Arrays of at least this many bytes come straight from anonymous `mmap`.
+    size_t mmap_threshold = size_t(1) << 21;
+    // Ask for huge pages: MAP_HUGETLB where reserved, transparent huge pages otherwise.
+    bool huge_pages = false;
+};
+
+// Frees arrays of trivial elements made by `MakeUniqueForOverwrite<T[]>`: unmaps `Length()`
+// bytes when the array was mapped, `delete[]`s it otherwise.
+class MunmapDeleter {
+public:
+    MunmapDeleter() = default;
+
+    explicit MunmapDeleter(size_t length) : length_(length) {
+    }
+
+    template <typename T>
+    void operator()(T* ptr) const noexcept {
+#ifdef SMART_PTRS_HAS_MMAP
+        if (length_) {
+            munmap(const_cast<std::remove_cv_t<T>*>(ptr), length_);
+            return;
+        }
+#endif
+        delete[] ptr;
+    }
+
+    // Mapped bytes, or 0 for heap arrays.
+    size_t Length() const {
+        return length_;
+    }
+
+#ifdef SMART_PTRS_HAS_MMAP
+    // Maps `bytes` of zero pages and sets `deleter` to unmap them; huge pages may
+    // round the length up.
+    static void* Map(size_t bytes, bool huge_pages, MunmapDeleter& deleter) {
+#ifdef MAP_HUGETLB
+        if (huge_pages) {
+            constexpr size_t kHugePage = size_t(1) << 21;
+            size_t rounded = (bytes + kHugePage - 1) & ~(kHugePage - 1);
+            if (void* address = MapAnonymous(rounded, MAP_HUGETLB)) {
+                deleter = MunmapDeleter(rounded);
+                return address;
+            }
+        }
+#endif
+        void* address = MapAnonymous(bytes, 0);
+        if (!address) {
+            ThrowOrAbort(std::bad_alloc());
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            madvise(address, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        deleter = MunmapDeleter(bytes);
+        return address;
+    }
+#endif
+
+private:
+#ifdef SMART_PTRS_HAS_MMAP
+    static void* MapAnonymous(size_t length, int extra_flags) {
+        void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+#endif
+
+    size_t length_ = 0;
+};
+
+// Array of `size` default-initialised elements. For trivial `T`, arrays of at least
+// `options.mmap_threshold` bytes are mapped anonymously, so pages are only faulted in (and
+// zeroed by the kernel) when first written; smaller ones come from `new T[size]`.
+// Other element types always use `new T[size]` and `DefaultDeleter`. A `size` whose byte
+// count overflows fails with `std::bad_array_new_length`.
+template <typename T>
+requires std::is_unbounded_array_v<T>
+auto MakeUniqueForOverwrite(size_t size, const BufferOptions& options = {}) {
+    using Element = std::remove_extent_t<T>;
+    if (size > SIZE_MAX / sizeof(Element)) {
+        ThrowOrAbort(std::bad_array_new_length());
+    }
+    if constexpr (std::is_trivial_v<Element>) {
+#ifdef SMART_PTRS_HAS_MMAP
+        size_t bytes = size * sizeof(Element);
+        if (bytes && bytes >= options.mmap_threshold) {
+            MunmapDeleter deleter;
+            void* address = MunmapDeleter::Map(bytes, options.huge_pages, deleter);
+            return UniquePtr<T, MunmapDeleter>(static_cast<Element*>(address), deleter);
+        }
+#else
+        (void)options;
+#endif
+        return UniquePtr<T, MunmapDeleter>(new Element[size]);
+    } else {
+        (void)options;
+        return UniquePtr<T>(new Element[size]);
+    }
+}
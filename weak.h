@@ -3,6 +3,8 @@
 #include "sw_fwd.h"  // Forward declaration
 #include "shared.h"
 
+#include <expected>
+
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
 template <typename T>
 class WeakPtr {
@@ -25,7 +27,7 @@ public:
         AddWeak();
     }
 
-    WeakPtr(WeakPtr&& other) : block_(other.block_), pointer_(other.pointer_) {
+    WeakPtr(WeakPtr&& other) noexcept : block_(other.block_), pointer_(other.pointer_) {
         other.block_ = nullptr;
         other.pointer_ = nullptr;
     }
@@ -54,7 +56,7 @@ public:
         AddWeak();
         return *this;
     }
-    WeakPtr& operator=(WeakPtr&& other) {
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
         if (this == &other) {
             return *this;
         }
@@ -82,7 +84,7 @@ public:
         block_ = nullptr;
     }
 
-    void Swap(WeakPtr& other) {
+    void Swap(WeakPtr& other) noexcept {
         std::swap(block_, other.block_);
         std::swap(pointer_, other.pointer_);
     }
@@ -109,16 +111,23 @@ public:
 
     SharedPtr<T> Lock() const {
         if (Expired()) {
-            SharedPtr<T> shared_pointer = SharedPtr<T>(block_, nullptr);
-            return shared_pointer;
+            return SharedPtr<T>();
         }
         SharedPtr<T> shared_pointer = SharedPtr<T>(block_, pointer_);
         if (block_) {
-            ++block_->strong_count;
+            block_->IncStrong();
         }
         return shared_pointer;
     }
 
+    // Promotion that reports an expired pointer as a value instead of throwing.
+    std::expected<SharedPtr<T>, BadWeakPtr> TryLock() const noexcept {
+        if (block_ && block_->strong_count == 0) {
+            return std::unexpected(BadWeakPtr());
+        }
+        return Lock();
+    }
+
 private:
     void AddWeak() {
         if (block_) {
@@ -129,16 +138,16 @@ private:
     void DeleteWeak() {
         if (block_) {
             --block_->weak_count;
-            if (block_->weak_count == 0 && block_->strong_count == 0) {
+            if (block_->Unobserved() && block_->strong_count == 0) {
                 if (block_->alive) {
                     if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
                         return;
                     }
-                    delete block_;
+                    block_->Deallocate();
                     pointer_ = nullptr;
                     block_ = nullptr;
                 } else {
-                    delete block_;
+                    block_->Deallocate();
                     pointer_ = nullptr;
                     block_ = nullptr;
                 }
@@ -148,8 +157,8 @@ private:
     void DeleteWeakFromThis() {
         if (block_) {
             --block_->weak_count;
-            if (block_->weak_count == 0 && block_->strong_count == 0) {
-                delete block_;
+            if (block_->Unobserved() && block_->strong_count == 0) {
+                block_->Deallocate();
                 pointer_ = nullptr;
                 block_ = nullptr;
             }
@@ -166,4 +175,6 @@ private:
 
     template <typename F>
     friend class EnableSharedFromThis;
+
+    friend struct BatchRelease;
 };